@@ -1,23 +1,67 @@
 #include <stdio.h>
+#include <string.h>
 #include "water_map.h"
 #include "log_macros.h"
 #include "log_stdout.h"
 #include "log_file.h"
+#include "build_manifest.h"
+
+//goes into every manifest hash, bump it whenever a change to building water maps changes their output
+#define AWATER_VERSION "awater 1"
+#define AWATER_MANIFEST "awater.manifest"
 
 int main(int argc, char **argv) {
 	eqLogInit(EQEMU_LOG_LEVEL);
 	eqLogRegister(std::shared_ptr<EQEmu::Log::LogBase>(new EQEmu::Log::LogStdOut()));
 	eqLogRegister(std::shared_ptr<EQEmu::Log::LogBase>(new EQEmu::Log::LogFile("awater.log")));
 
-	for(int i = 1; i < argc; ++i) {
+	int i = 1;
+	bool force = false;
+	while (i < argc && strncmp(argv[i], "--", 2) == 0) {
+		if (strcmp(argv[i], "--Force") == 0) {
+			force = true;
+		} else {
+			eqLogMessage(LogError, "Unknown option %s", argv[i]);
+			return 1;
+		}
+		++i;
+	}
+
+	//zones whose inputs hash the same as last time and still have their output are skipped
+	EQEmu::BuildManifest manifest;
+	manifest.Load(AWATER_MANIFEST);
+
+	for(; i < argc; ++i) {
+		std::string zone_name = argv[i];
+		std::vector<std::string> inputs = { zone_name + ".eqg", zone_name + ".zon", zone_name + ".s3d" };
+		std::string hash = EQEmu::BuildManifest::Hash(AWATER_VERSION, inputs);
+
+		bool output_exists = false;
+		FILE *out = fopen((zone_name + ".wtr").c_str(), "rb");
+		if (out) {
+			output_exists = true;
+			fclose(out);
+		}
+
+		if (!force && output_exists && manifest.IsCurrent(zone_name, hash)) {
+			eqLogMessage(LogInfo, "Skipping water map for zone %s, its inputs have not changed since the last build", argv[i]);
+			continue;
+		}
+
 		WaterMap m;
 		eqLogMessage(LogInfo, "Building water map for zone %s", argv[i]);
 		if(!m.BuildAndWrite(argv[i])) {
 			eqLogMessage(LogError, "Failed to build and write water map for zone: %s", argv[i]);
+			manifest.Remove(zone_name);
 		} else {
 			eqLogMessage(LogInfo, "Built and wrote water map for zone %s", argv[i]);
+			manifest.Set(zone_name, hash);
 		}
 	}
 
+	if (!manifest.Save(AWATER_MANIFEST)) {
+		eqLogMessage(LogWarn, "Failed to save %s, the next run will rebuild every zone", AWATER_MANIFEST);
+	}
+
 	return 0;
 }
@@ -2,7 +2,159 @@
 #include "log_macros.h"
 #include "log_stdout.h"
 #include "log_file.h"
+#include "config.h"
+#include "thread_pool.h"
+#include "build_manifest.h"
 #include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+
+//goes into every manifest hash, bump it whenever a change to building or writing maps changes their output
+#define AZONE_VERSION "azone 1"
+#define AZONE_MANIFEST "azone.manifest"
+//how far --OptimizeCollision may move the collision surface when no tolerance is given
+#define AZONE_OPTIMIZE_TOLERANCE 0.05f
+
+struct BuildOptions
+{
+	bool ignore_collide_tex;
+	//negative leaves the collision mesh as built
+	float optimize_tolerance;
+	MapWriteOptions write_opts;
+	//the version and every flag that changes the output, part of the manifest hash
+	std::string settings;
+	EQEmu::BuildManifest *manifest;
+	//rebuild even when the manifest says a zone is current
+	bool force;
+};
+
+struct ZoneResult
+{
+	ZoneResult() : skipped(false), built(false), written(false), seconds(0.0), built_collide_tris(0), collide_tris(0), non_collide_tris(0), file_size(0) { }
+
+	bool skipped;
+	bool built;
+	bool written;
+	double seconds;
+	//before the optimize pass, the same as collide_tris without it
+	size_t built_collide_tris;
+	size_t collide_tris;
+	size_t non_collide_tris;
+	long file_size;
+};
+
+long FileSize(const std::string &filename) {
+	FILE *f = fopen(filename.c_str(), "rb");
+	if (!f) {
+		return -1;
+	}
+
+	fseek(f, 0, SEEK_END);
+	long sz = ftell(f);
+	fclose(f);
+	return sz;
+}
+
+//everything Map::Build can read for a zone
+std::vector<std::string> ZoneInputs(const std::string &zone_name) {
+	return {
+		zone_name + ".eqg",
+		zone_name + ".zon",
+		zone_name + ".s3d",
+		zone_name + "_obj.s3d",
+		zone_name + ".ignore"
+	};
+}
+
+//the map only lives for the duration of this call so memory is bounded by how many builds run at once
+void BuildZone(const std::string &zone_name, const BuildOptions &opts, ZoneResult &res) {
+	auto start = std::chrono::steady_clock::now();
+	std::string filename = zone_name + ".map";
+
+	std::string hash = EQEmu::BuildManifest::Hash(opts.settings, ZoneInputs(zone_name));
+	if (!opts.force && opts.manifest->IsCurrent(zone_name, hash) && FileSize(filename) >= 0) {
+		eqLogMessage(LogInfo, "Skipping zone %s, its inputs have not changed since the last build", zone_name.c_str());
+		res.skipped = true;
+		res.written = true;
+		res.file_size = FileSize(filename);
+		res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return;
+	}
+
+	Map m;
+	eqLogMessage(LogInfo, "Attempting to build map for zone: %s", zone_name.c_str());
+	if(!m.Build(zone_name, opts.ignore_collide_tex)) {
+		eqLogMessage(LogError, "Failed to build map for zone: %s", zone_name.c_str());
+	} else {
+		res.built = true;
+		res.built_collide_tris = m.GetCollidableTriangleCount();
+		if (opts.optimize_tolerance >= 0.0f) {
+			CollisionOptimizeStats stats;
+			m.OptimizeCollision(opts.optimize_tolerance, stats);
+		}
+
+		res.collide_tris = m.GetCollidableTriangleCount();
+		res.non_collide_tris = m.GetNonCollidableTriangleCount();
+		if(!m.Write(filename, opts.write_opts)) {
+			eqLogMessage(LogError, "Failed to write map for zone %s", zone_name.c_str());
+		} else {
+			res.written = true;
+			eqLogMessage(LogInfo, "Wrote map for zone: %s", zone_name.c_str());
+		}
+	}
+
+	if (res.written) {
+		res.file_size = FileSize(filename);
+	}
+
+	if (res.written) {
+		opts.manifest->Set(zone_name, hash);
+	} else {
+		opts.manifest->Remove(zone_name);
+	}
+
+	res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void PrintSummary(const std::vector<std::string> &zones, const std::vector<ZoneResult> &results, double seconds, bool optimized) {
+	size_t width = 4;
+	for (auto &zone : zones) {
+		width = std::max(width, zone.length());
+	}
+
+	size_t failed = 0;
+	size_t skipped = 0;
+	size_t built_collide_tris = 0;
+	size_t collide_tris = 0;
+	printf("%-*s %-8s %10s %14s %14s %12s\n", (int)width, "zone", "result", "seconds", "collide tris", "other tris", "map KB");
+	for (size_t i = 0; i < zones.size(); ++i) {
+		auto &res = results[i];
+		const char *status = res.skipped ? "skipped" : (res.written ? "ok" : (res.built ? "nowrite" : "nobuild"));
+		if (!res.written) {
+			++failed;
+		}
+
+		if (res.skipped) {
+			++skipped;
+		}
+
+		built_collide_tris += res.built_collide_tris;
+		collide_tris += res.collide_tris;
+
+		printf("%-*s %-8s %10.2f %14llu %14llu %12ld\n", (int)width, zones[i].c_str(), status, res.seconds,
+			(unsigned long long)res.collide_tris, (unsigned long long)res.non_collide_tris, std::max(res.file_size, 0L) / 1024);
+	}
+
+	printf("%llu zones, %llu skipped, %llu failed, %.2f seconds\n", (unsigned long long)zones.size(), (unsigned long long)skipped,
+		(unsigned long long)failed, seconds);
+
+	if (optimized) {
+		printf("collision triangles optimized from %llu to %llu\n", (unsigned long long)built_collide_tris, (unsigned long long)collide_tris);
+	}
+}
 
 int main(int argc, char **argv) {
 	eqLogInit(EQEMU_LOG_LEVEL);
@@ -11,25 +163,96 @@ int main(int argc, char **argv) {
 
 	int i = 1;
 	bool ignore_collide_tex = true;
-	if (argc > 2) {
-		if (strcmp(argv[1], "--IncludeCollideTex") == 0) {
+	bool force = false;
+	float optimize_tolerance = -1.0f;
+	MapWriteOptions write_opts;
+	size_t jobs = 1;
+	while (i < argc && argv[i][0] == '-') {
+		if (strcmp(argv[i], "--IncludeCollideTex") == 0) {
 			ignore_collide_tex = false;
-			i = 2;
+		} else if (strcmp(argv[i], "--MapVersion=2") == 0) {
+			write_opts.version = 2;
+		} else if (strcmp(argv[i], "--MapVersion=3") == 0) {
+			write_opts.version = 3;
+		} else if (strcmp(argv[i], "--MapVersion=4") == 0) {
+			write_opts.version = 4;
+		} else if (strcmp(argv[i], "--Force") == 0) {
+			force = true;
+		} else if (strcmp(argv[i], "--OptimizeCollision") == 0) {
+			optimize_tolerance = AZONE_OPTIMIZE_TOLERANCE;
+		} else if (strncmp(argv[i], "--OptimizeCollision=", 20) == 0) {
+			//0 only drops degenerate and duplicate triangles
+			char *end = nullptr;
+			optimize_tolerance = strtof(argv[i] + 20, &end);
+			if (argv[i][20] == 0 || *end != 0 || optimize_tolerance < 0.0f) {
+				eqLogMessage(LogError, "Invalid collision tolerance %s", argv[i] + 20);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--ChunkedPayload") == 0) {
+			write_opts.chunked_payload = true;
+		} else if (strncmp(argv[i], "--ChunkSize=", 12) == 0) {
+			write_opts.chunk_size = (float)atof(argv[i] + 12);
+			if (write_opts.chunk_size <= 0.0f) {
+				eqLogMessage(LogError, "Invalid chunk size %s", argv[i] + 12);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-j") == 0 || strncmp(argv[i], "-j=", 3) == 0) {
+			//zones to build at once, 0 uses every core
+			const char *count_str = argv[i][2] == '=' ? argv[i] + 3 : (i + 1 < argc ? argv[++i] : "");
+			char *end = nullptr;
+			long count = strtol(count_str, &end, 10);
+			if (*count_str == 0 || *end != 0 || count < 0) {
+				eqLogMessage(LogError, "Invalid job count %s", count_str);
+				return 1;
+			}
+
+			jobs = count == 0 ? std::max(std::thread::hardware_concurrency(), 1U) : (size_t)count;
+		} else {
+			eqLogMessage(LogError, "Unknown option %s", argv[i]);
+			return 1;
 		}
+		++i;
 	}
 
-	for(; i < argc; ++i) {
-		Map m;
-		eqLogMessage(LogInfo, "Attempting to build map for zone: %s", argv[i]);
-		if(!m.Build(argv[i], ignore_collide_tex)) {
-			eqLogMessage(LogError, "Failed to build map for zone: %s", argv[i]);
-		} else {
-			if(!m.Write(std::string(argv[i]) + std::string(".map"))) {
-				eqLogMessage(LogError, "Failed to write map for zone %s", argv[i]);
-			} else {
-				eqLogMessage(LogInfo, "Wrote map for zone: %s", argv[i]);
-			}
+	write_opts.compression = Config::Instance().GetCompression("map", EQEmu::CompressionOptions());
+
+	BuildOptions opts;
+	opts.ignore_collide_tex = ignore_collide_tex;
+	opts.optimize_tolerance = optimize_tolerance;
+	opts.write_opts = write_opts;
+	char settings[256];
+	snprintf(settings, sizeof(settings), "%s collide_tex=%d optimize=%g version=%u chunked=%d chunk_size=%g level=%d strategy=%d window=%d mem=%d",
+		AZONE_VERSION, ignore_collide_tex ? 0 : 1, optimize_tolerance, write_opts.version, write_opts.chunked_payload ? 1 : 0, write_opts.chunk_size,
+		write_opts.compression.level, write_opts.compression.strategy, write_opts.compression.window_bits, write_opts.compression.mem_level);
+	opts.settings = settings;
+
+	//--Force still records what it built so the next run can skip it
+	EQEmu::BuildManifest manifest;
+	manifest.Load(AZONE_MANIFEST);
+	opts.manifest = &manifest;
+	opts.force = force;
+
+	std::vector<std::string> zones(argv + i, argv + argc);
+	std::vector<ZoneResult> results(zones.size());
+	auto start = std::chrono::steady_clock::now();
+	if (jobs <= 1) {
+		for (size_t j = 0; j < zones.size(); ++j) {
+			BuildZone(zones[j], opts, results[j]);
 		}
+	} else {
+		//each zone is independent, builds still spread their own work over the shared pool
+		EQEmu::ThreadPool pool(jobs);
+		pool.ParallelFor(zones.size(), [&](size_t j) {
+			BuildZone(zones[j], opts, results[j]);
+		});
+	}
+
+	if (!zones.empty() && !manifest.Save(AZONE_MANIFEST)) {
+		eqLogMessage(LogWarn, "Failed to save %s, the next run will rebuild every zone", AZONE_MANIFEST);
+	}
+
+	if (zones.size() > 1) {
+		PrintSummary(zones, results, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), optimize_tolerance >= 0.0f);
 	}
 
 	return 0;
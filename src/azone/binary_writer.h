@@ -0,0 +1,59 @@
+#ifndef EQEMU_AZONE_BINARY_WRITER_H
+#define EQEMU_AZONE_BINARY_WRITER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+//Appends values to a single buffer that is sized once up front. Output is little-endian, which every
+//platform we build on is and every map reader assumes, so values and whole arrays are plain memcpys
+class BinaryWriter
+{
+public:
+	BinaryWriter() : pos(0) { }
+
+	void Reserve(size_t size) {
+		if (size > buffer.size()) {
+			buffer.resize(size);
+		}
+	}
+
+	template<typename T>
+	void Write(const T &v) {
+		WriteBytes(&v, sizeof(T));
+	}
+
+	template<typename T>
+	void WriteArray(const T *v, size_t count) {
+		WriteBytes(v, sizeof(T) * count);
+	}
+
+	//null terminated
+	void WriteString(const std::string &s) {
+		WriteBytes(s.c_str(), s.length() + 1);
+	}
+
+	void WriteBytes(const void *data, size_t len) {
+		if (len == 0) {
+			return;
+		}
+
+		//only happens if the reserve was short, still correct just not a single allocation
+		if (pos + len > buffer.size()) {
+			buffer.resize(std::max(pos + len, buffer.size() * 2));
+		}
+
+		memcpy(&buffer[pos], data, len);
+		pos += len;
+	}
+
+	const char *Data() const { return buffer.data(); }
+	size_t Size() const { return pos; }
+private:
+	std::vector<char> buffer;
+	size_t pos;
+};
+
+#endif
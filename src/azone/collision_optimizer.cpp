@@ -0,0 +1,481 @@
+#include "collision_optimizer.h"
+#include <math.h>
+#include <algorithm>
+#include <tuple>
+
+//triangles thinner than this are zero area for collision purposes
+#define COLLISION_DEGENERATE_HEIGHT 0.0001f
+//cos of the most a triangle's facing may differ from its region's, about 1 degree
+#define COLLISION_COPLANAR_DOT 0.99985f
+//how far off a straight boundary a vert may be and still be removed from it, relative to the edge length
+#define COLLISION_COLLINEAR_EPSILON 0.00001f
+#define COLLISION_NO_REGION 0xFFFFFFFFu
+
+struct OptimizeState
+{
+	const std::vector<glm::vec3> *verts;
+	std::vector<uint32_t> tris;
+	std::vector<uint8_t> alive;
+	std::vector<uint32_t> region;
+	std::vector<glm::vec3> region_normals;
+	std::vector<std::vector<uint32_t>> vert_tris;
+	float cos_max;
+};
+
+//twice the area over the longest edge squared, 0 for a degenerate triangle and about 0.87 for an equilateral one
+static float TriangleQuality(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, glm::vec3 &normal) {
+	glm::vec3 cr = glm::cross(b - a, c - a);
+	float area2 = glm::length(cr);
+	float longest = std::max(glm::dot(b - a, b - a), std::max(glm::dot(c - b, c - b), glm::dot(a - c, a - c)));
+	if (longest <= 0.0f || area2 <= COLLISION_DEGENERATE_HEIGHT * sqrtf(longest)) {
+		normal = glm::vec3(0.0f);
+		return 0.0f;
+	}
+
+	normal = cr / area2;
+	return area2 / longest;
+}
+
+static void RemoveDegenerates(OptimizeState &s, CollisionOptimizeStats &stats) {
+	auto &verts = *s.verts;
+	size_t tri_count = s.tris.size() / 3;
+	for (size_t t = 0; t < tri_count; ++t) {
+		uint32_t *tri = &s.tris[t * 3];
+		glm::vec3 n;
+		if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2] || TriangleQuality(verts[tri[0]], verts[tri[1]], verts[tri[2]], n) == 0.0f) {
+			s.alive[t] = 0;
+			++stats.degenerates;
+		}
+	}
+}
+
+//triangles are compared rotated to start at their lowest index so winding still counts,
+//a copy facing the other way is a different surface to anything that culls back faces
+static void RemoveDuplicates(OptimizeState &s, CollisionOptimizeStats &stats) {
+	std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>> keys;
+	size_t tri_count = s.tris.size() / 3;
+	keys.reserve(tri_count);
+	for (size_t t = 0; t < tri_count; ++t) {
+		if (!s.alive[t]) {
+			continue;
+		}
+
+		uint32_t *tri = &s.tris[t * 3];
+		int first = tri[0] < tri[1] ? (tri[0] < tri[2] ? 0 : 2) : (tri[1] < tri[2] ? 1 : 2);
+		keys.emplace_back(tri[first], tri[(first + 1) % 3], tri[(first + 2) % 3], (uint32_t)t);
+	}
+
+	std::sort(keys.begin(), keys.end());
+	for (size_t i = 1; i < keys.size(); ++i) {
+		auto &prev = keys[i - 1];
+		auto &cur = keys[i];
+		if (std::get<0>(prev) == std::get<0>(cur) && std::get<1>(prev) == std::get<1>(cur) && std::get<2>(prev) == std::get<2>(cur)) {
+			s.alive[std::get<3>(cur)] = 0;
+			++stats.duplicates;
+		}
+	}
+}
+
+//flood fills across edges shared by exactly two triangles, a triangle joins a region if it faces the same
+//way as the region's first triangle and all of its verts are within half the tolerance of that plane
+static void BuildRegions(OptimizeState &s, float tolerance) {
+	auto &verts = *s.verts;
+	size_t tri_count = s.tris.size() / 3;
+
+	std::vector<std::pair<uint64_t, uint32_t>> edges;
+	edges.reserve(tri_count * 3);
+	for (size_t t = 0; t < tri_count; ++t) {
+		if (!s.alive[t]) {
+			continue;
+		}
+
+		for (int i = 0; i < 3; ++i) {
+			uint32_t a = s.tris[t * 3 + i];
+			uint32_t b = s.tris[t * 3 + (i + 1) % 3];
+			edges.emplace_back(((uint64_t)std::min(a, b) << 32) | std::max(a, b), (uint32_t)t);
+		}
+	}
+
+	std::sort(edges.begin(), edges.end());
+
+	//manifold edges only, three triangles on an edge is a seam we leave alone
+	std::vector<uint32_t> neighbor_start(tri_count + 1, 0);
+	std::vector<std::pair<uint32_t, uint32_t>> pairs;
+	for (size_t i = 0; i < edges.size();) {
+		size_t j = i + 1;
+		while (j < edges.size() && edges[j].first == edges[i].first) {
+			++j;
+		}
+
+		if (j - i == 2) {
+			pairs.emplace_back(edges[i].second, edges[i + 1].second);
+			++neighbor_start[edges[i].second + 1];
+			++neighbor_start[edges[i + 1].second + 1];
+		}
+
+		i = j;
+	}
+
+	for (size_t t = 0; t < tri_count; ++t) {
+		neighbor_start[t + 1] += neighbor_start[t];
+	}
+
+	std::vector<uint32_t> neighbors(neighbor_start[tri_count]);
+	std::vector<uint32_t> fill(neighbor_start.begin(), neighbor_start.end() - 1);
+	for (auto &p : pairs) {
+		neighbors[fill[p.first]++] = p.second;
+		neighbors[fill[p.second]++] = p.first;
+	}
+
+	float max_dist = tolerance * 0.5f;
+	std::vector<uint32_t> open;
+	for (size_t seed = 0; seed < tri_count; ++seed) {
+		if (!s.alive[seed] || s.region[seed] != COLLISION_NO_REGION) {
+			continue;
+		}
+
+		uint32_t *seed_tri = &s.tris[seed * 3];
+		glm::vec3 normal;
+		TriangleQuality(verts[seed_tri[0]], verts[seed_tri[1]], verts[seed_tri[2]], normal);
+		float d = glm::dot(normal, verts[seed_tri[0]]);
+		uint32_t id = (uint32_t)s.region_normals.size();
+		s.region_normals.push_back(normal);
+
+		s.region[seed] = id;
+		open.push_back((uint32_t)seed);
+		while (!open.empty()) {
+			uint32_t t = open.back();
+			open.pop_back();
+
+			for (uint32_t i = neighbor_start[t]; i < neighbor_start[t + 1]; ++i) {
+				uint32_t n = neighbors[i];
+				if (s.region[n] != COLLISION_NO_REGION) {
+					continue;
+				}
+
+				uint32_t *tri = &s.tris[n * 3];
+				glm::vec3 tri_normal;
+				TriangleQuality(verts[tri[0]], verts[tri[1]], verts[tri[2]], tri_normal);
+				if (glm::dot(tri_normal, normal) < s.cos_max) {
+					continue;
+				}
+
+				if (fabsf(glm::dot(normal, verts[tri[0]]) - d) > max_dist ||
+					fabsf(glm::dot(normal, verts[tri[1]]) - d) > max_dist ||
+					fabsf(glm::dot(normal, verts[tri[2]]) - d) > max_dist) {
+					continue;
+				}
+
+				s.region[n] = id;
+				open.push_back(n);
+			}
+		}
+	}
+}
+
+//the verts v can be moved onto, empty if v has to stay. Every triangle using v must be in one region and
+//v must either be surrounded by it or sit on a straight stretch of open edge, where it can only slide along that edge
+static void CollapseCandidates(OptimizeState &s, uint32_t v, std::vector<uint32_t> &out) {
+	out.clear();
+	auto &tris = s.vert_tris[v];
+	if (tris.empty()) {
+		return;
+	}
+
+	uint32_t r = s.region[tris[0]];
+	std::vector<std::pair<uint32_t, uint32_t>> edge_counts;
+	for (auto t : tris) {
+		if (s.region[t] != r) {
+			return;
+		}
+
+		for (int i = 0; i < 3; ++i) {
+			uint32_t w = s.tris[t * 3 + i];
+			if (w == v) {
+				continue;
+			}
+
+			auto iter = std::find_if(edge_counts.begin(), edge_counts.end(), [w](const std::pair<uint32_t, uint32_t> &e) { return e.first == w; });
+			if (iter == edge_counts.end()) {
+				edge_counts.emplace_back(w, 1);
+			} else {
+				++iter->second;
+			}
+		}
+	}
+
+	//v has to be the tip of a single fan, two fans meeting at v would both be moved
+	std::vector<uint32_t> reached(1, tris[0]);
+	for (size_t i = 0; i < reached.size(); ++i) {
+		uint32_t *from = &s.tris[reached[i] * 3];
+		for (auto t : tris) {
+			if (std::find(reached.begin(), reached.end(), t) != reached.end()) {
+				continue;
+			}
+
+			uint32_t *to = &s.tris[t * 3];
+			bool shares_edge = false;
+			for (int j = 0; j < 3; ++j) {
+				if (from[j] != v && (to[0] == from[j] || to[1] == from[j] || to[2] == from[j])) {
+					shares_edge = true;
+				}
+			}
+
+			if (shares_edge) {
+				reached.push_back(t);
+			}
+		}
+	}
+
+	if (reached.size() != tris.size()) {
+		return;
+	}
+
+	uint32_t open_edges[2];
+	size_t open_count = 0;
+	for (auto &e : edge_counts) {
+		if (e.second > 2) {
+			return;
+		}
+
+		if (e.second == 1) {
+			if (open_count == 2) {
+				return;
+			}
+
+			open_edges[open_count++] = e.first;
+		}
+	}
+
+	if (open_count == 0) {
+		for (auto &e : edge_counts) {
+			out.push_back(e.first);
+		}
+		return;
+	}
+
+	if (open_count != 2) {
+		return;
+	}
+
+	auto &verts = *s.verts;
+	glm::vec3 a = verts[open_edges[0]];
+	glm::vec3 ab = verts[open_edges[1]] - a;
+	glm::vec3 av = verts[v] - a;
+	float len2 = glm::dot(ab, ab);
+	float along = glm::dot(av, ab);
+	if (len2 <= 0.0f || along <= 0.0f || along >= len2) {
+		return;
+	}
+
+	float off = glm::length(glm::cross(ab, av)) / sqrtf(len2);
+	if (off > COLLISION_COLLINEAR_EPSILON * sqrtf(len2)) {
+		return;
+	}
+
+	out.push_back(open_edges[0]);
+	out.push_back(open_edges[1]);
+}
+
+//how good the triangles around v are once v is moved onto u, 0 if that would fold, flatten or tilt one
+//or break the link condition (which keeps the mesh manifold)
+static float ScoreCollapse(OptimizeState &s, uint32_t v, uint32_t u) {
+	auto &verts = *s.verts;
+	auto &tris = s.vert_tris[v];
+
+	size_t shared_tris = 0;
+	std::vector<uint32_t> v_ring;
+	for (auto t : tris) {
+		bool has_u = false;
+		for (int i = 0; i < 3; ++i) {
+			uint32_t w = s.tris[t * 3 + i];
+			if (w == u) {
+				has_u = true;
+			} else if (w != v) {
+				v_ring.push_back(w);
+			}
+		}
+
+		if (has_u) {
+			++shared_tris;
+		}
+	}
+
+	std::sort(v_ring.begin(), v_ring.end());
+	v_ring.erase(std::unique(v_ring.begin(), v_ring.end()), v_ring.end());
+
+	std::vector<uint32_t> u_ring;
+	for (auto t : s.vert_tris[u]) {
+		for (int i = 0; i < 3; ++i) {
+			uint32_t w = s.tris[t * 3 + i];
+			if (w != u && w != v) {
+				u_ring.push_back(w);
+			}
+		}
+	}
+
+	std::sort(u_ring.begin(), u_ring.end());
+	u_ring.erase(std::unique(u_ring.begin(), u_ring.end()), u_ring.end());
+
+	size_t common = 0;
+	for (auto w : v_ring) {
+		if (std::binary_search(u_ring.begin(), u_ring.end(), w)) {
+			++common;
+		}
+	}
+
+	if (common != shared_tris) {
+		return 0.0f;
+	}
+
+	float worst = 1.0f;
+	for (auto t : tris) {
+		uint32_t *tri = &s.tris[t * 3];
+		if (tri[0] == u || tri[1] == u || tri[2] == u) {
+			continue;
+		}
+
+		glm::vec3 p[3];
+		for (int i = 0; i < 3; ++i) {
+			p[i] = verts[tri[i] == v ? u : tri[i]];
+		}
+
+		glm::vec3 old_normal;
+		TriangleQuality(verts[tri[0]], verts[tri[1]], verts[tri[2]], old_normal);
+
+		glm::vec3 normal;
+		float q = TriangleQuality(p[0], p[1], p[2], normal);
+		if (q == 0.0f || glm::dot(normal, old_normal) <= 0.0f || glm::dot(normal, s.region_normals[s.region[t]]) < s.cos_max) {
+			return 0.0f;
+		}
+
+		worst = std::min(worst, q);
+	}
+
+	return worst;
+}
+
+static void RemoveTriFromVert(OptimizeState &s, uint32_t vert, uint32_t t) {
+	auto &list = s.vert_tris[vert];
+	auto iter = std::find(list.begin(), list.end(), t);
+	if (iter != list.end()) {
+		*iter = list.back();
+		list.pop_back();
+	}
+}
+
+static void Collapse(OptimizeState &s, uint32_t v, uint32_t u, CollisionOptimizeStats &stats) {
+	std::vector<uint32_t> tris;
+	tris.swap(s.vert_tris[v]);
+	for (auto t : tris) {
+		uint32_t *tri = &s.tris[t * 3];
+		if (tri[0] == u || tri[1] == u || tri[2] == u) {
+			s.alive[t] = 0;
+			++stats.merged;
+			for (int i = 0; i < 3; ++i) {
+				if (tri[i] != v) {
+					RemoveTriFromVert(s, tri[i], t);
+				}
+			}
+			continue;
+		}
+
+		for (int i = 0; i < 3; ++i) {
+			if (tri[i] == v) {
+				tri[i] = u;
+			}
+		}
+
+		s.vert_tris[u].push_back(t);
+	}
+}
+
+static void MergeRegions(OptimizeState &s, CollisionOptimizeStats &stats) {
+	size_t tri_count = s.tris.size() / 3;
+	size_t vert_count = s.verts->size();
+	s.vert_tris.resize(vert_count);
+	for (size_t t = 0; t < tri_count; ++t) {
+		if (!s.alive[t]) {
+			continue;
+		}
+
+		for (int i = 0; i < 3; ++i) {
+			s.vert_tris[s.tris[t * 3 + i]].push_back((uint32_t)t);
+		}
+	}
+
+	//every removal can free up its neighbours so they go back on the queue
+	std::vector<uint32_t> queue;
+	std::vector<uint8_t> queued(vert_count, 1);
+	queue.reserve(vert_count);
+	for (size_t v = vert_count; v > 0; --v) {
+		queue.push_back((uint32_t)(v - 1));
+	}
+
+	std::vector<uint32_t> candidates;
+	while (!queue.empty()) {
+		uint32_t v = queue.back();
+		queue.pop_back();
+		queued[v] = 0;
+
+		CollapseCandidates(s, v, candidates);
+		uint32_t best = 0;
+		float best_score = 0.0f;
+		for (auto u : candidates) {
+			float score = ScoreCollapse(s, v, u);
+			if (score > best_score) {
+				best_score = score;
+				best = u;
+			}
+		}
+
+		if (best_score == 0.0f) {
+			continue;
+		}
+
+		std::vector<uint32_t> ring;
+		for (auto t : s.vert_tris[v]) {
+			for (int i = 0; i < 3; ++i) {
+				ring.push_back(s.tris[t * 3 + i]);
+			}
+		}
+
+		Collapse(s, v, best, stats);
+		for (auto w : ring) {
+			if (w != v && !queued[w]) {
+				queued[w] = 1;
+				queue.push_back(w);
+			}
+		}
+	}
+}
+
+void OptimizeCollisionMesh(const std::vector<glm::vec3> &verts, const std::vector<uint32_t> &indices, float tolerance,
+	std::vector<uint32_t> &out_indices, CollisionOptimizeStats &stats) {
+	size_t tri_count = indices.size() / 3;
+	stats = CollisionOptimizeStats();
+	stats.triangles_before = tri_count;
+
+	OptimizeState s;
+	s.verts = &verts;
+	s.tris.assign(indices.begin(), indices.begin() + tri_count * 3);
+	s.alive.assign(tri_count, 1);
+	s.region.assign(tri_count, COLLISION_NO_REGION);
+	s.cos_max = COLLISION_COPLANAR_DOT;
+
+	RemoveDegenerates(s, stats);
+	RemoveDuplicates(s, stats);
+	if (tolerance > 0.0f) {
+		BuildRegions(s, tolerance);
+		MergeRegions(s, stats);
+	}
+
+	out_indices.clear();
+	for (size_t t = 0; t < tri_count; ++t) {
+		if (s.alive[t]) {
+			out_indices.insert(out_indices.end(), s.tris.begin() + t * 3, s.tris.begin() + t * 3 + 3);
+		}
+	}
+
+	stats.triangles_after = out_indices.size() / 3;
+}
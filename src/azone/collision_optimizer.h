@@ -0,0 +1,30 @@
+#ifndef EQEMU_AZONE_COLLISION_OPTIMIZER_H
+#define EQEMU_AZONE_COLLISION_OPTIMIZER_H
+
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct CollisionOptimizeStats
+{
+	CollisionOptimizeStats() : triangles_before(0), degenerates(0), duplicates(0), merged(0), triangles_after(0) { }
+
+	size_t triangles_before;
+	//zero area triangles dropped
+	size_t degenerates;
+	//exact copies of an earlier triangle with the same winding dropped
+	size_t duplicates;
+	//triangles removed by re-triangulating coplanar regions
+	size_t merged;
+	size_t triangles_after;
+};
+
+//Cleans up a collision mesh: drops degenerate and duplicate triangles, then re-triangulates connected
+//coplanar regions with fewer triangles by removing verts that sit inside a region or along one of its
+//straight edges. Verts are never moved, every region lies within tolerance / 2 of its plane and keeps
+//its facing, so the surface never strays more than tolerance from the original.
+//Writes the surviving triangles into out_indices, still indexing verts
+void OptimizeCollisionMesh(const std::vector<glm::vec3> &verts, const std::vector<uint32_t> &indices, float tolerance,
+	std::vector<uint32_t> &out_indices, CollisionOptimizeStats &stats);
+
+#endif
@@ -0,0 +1,127 @@
+#include "dedup_mesh.h"
+#include <string.h>
+
+#define DEDUP_EMPTY_SLOT 0xFFFFFFFFu
+
+//-0 and 0 compare equal as floats so they have to share a key too
+static inline uint32_t CoordBits(float f) {
+	if (f == 0.0f) {
+		return 0;
+	}
+
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+static inline bool SameVertex(const glm::vec3 &a, const glm::vec3 &b) {
+	return CoordBits(a.x) == CoordBits(b.x) && CoordBits(a.y) == CoordBits(b.y) && CoordBits(a.z) == CoordBits(b.z);
+}
+
+static inline uint64_t HashVertex(const glm::vec3 &v) {
+	uint64_t h = CoordBits(v.x) * 0x9E3779B97F4A7C15ull;
+	h ^= CoordBits(v.y) * 0xC2B2AE3D27D4EB4Full;
+	h ^= CoordBits(v.z) * 0x165667B19E3779F9ull;
+	h ^= h >> 29;
+	h *= 0xBF58476D1CE4E5B9ull;
+	h ^= h >> 32;
+	return h;
+}
+
+DedupMesh::DedupMesh() : hashed(0) {
+}
+
+void DedupMesh::Clear() {
+	verts.clear();
+	indices.clear();
+	table.clear();
+	hashed = 0;
+}
+
+void DedupMesh::Reserve(size_t vert_count) {
+	verts.reserve(vert_count);
+	ReserveTable(vert_count);
+}
+
+void DedupMesh::AddFace(const glm::vec3 &v1, const glm::vec3 &v2, const glm::vec3 &v3) {
+	indices.push_back(AddVertex(v1));
+	indices.push_back(AddVertex(v2));
+	indices.push_back(AddVertex(v3));
+}
+
+uint32_t DedupMesh::AddUniqueVertex(const glm::vec3 &v) {
+	verts.push_back(v);
+	return (uint32_t)verts.size() - 1;
+}
+
+void DedupMesh::Merge(const DedupMesh &other) {
+	ReserveTable(hashed + other.verts.size());
+
+	std::vector<uint32_t> remap(other.verts.size(), DEDUP_EMPTY_SLOT);
+	for (auto idx : other.indices) {
+		if (remap[idx] == DEDUP_EMPTY_SLOT) {
+			remap[idx] = AddVertex(other.verts[idx]);
+		}
+
+		indices.push_back(remap[idx]);
+	}
+}
+
+uint32_t DedupMesh::AddVertex(const glm::vec3 &v) {
+	if ((hashed + 1) * 10 > table.size() * 7) {
+		Rehash(table.empty() ? 1024 : table.size() * 2);
+	}
+
+	size_t mask = table.size() - 1;
+	size_t slot = (size_t)HashVertex(v) & mask;
+	for (;;) {
+		uint32_t idx = table[slot];
+		if (idx == DEDUP_EMPTY_SLOT) {
+			break;
+		}
+
+		if (SameVertex(verts[idx], v)) {
+			return idx;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+
+	uint32_t idx = (uint32_t)verts.size();
+	verts.push_back(v);
+	table[slot] = idx;
+	++hashed;
+	return idx;
+}
+
+void DedupMesh::ReserveTable(size_t vert_count) {
+	//keep the load factor under 0.7
+	size_t capacity = 1024;
+	while (capacity * 7 < vert_count * 10) {
+		capacity <<= 1;
+	}
+
+	if (capacity > table.size()) {
+		Rehash(capacity);
+	}
+}
+
+void DedupMesh::Rehash(size_t capacity) {
+	std::vector<uint32_t> old;
+	old.swap(table);
+	table.assign(capacity, DEDUP_EMPTY_SLOT);
+
+	size_t mask = capacity - 1;
+	for (auto idx : old) {
+		if (idx == DEDUP_EMPTY_SLOT) {
+			continue;
+		}
+
+		size_t slot = (size_t)HashVertex(verts[idx]) & mask;
+		while (table[slot] != DEDUP_EMPTY_SLOT) {
+			slot = (slot + 1) & mask;
+		}
+
+		table[slot] = idx;
+	}
+}
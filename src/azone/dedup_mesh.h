@@ -0,0 +1,41 @@
+#ifndef EQEMU_AZONE_DEDUP_MESH_H
+#define EQEMU_AZONE_DEDUP_MESH_H
+
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+//Vertex and index buffers that share identical verts. Lookups go through an open addressing table of
+//vertex indices keyed on the coordinates' bit patterns, so a vert costs a hash and usually one probe
+class DedupMesh
+{
+public:
+	DedupMesh();
+
+	void Clear();
+	//sizes the table for this many unique verts so building up to it never rehashes
+	void Reserve(size_t vert_count);
+
+	void AddFace(const glm::vec3 &v1, const glm::vec3 &v2, const glm::vec3 &v3);
+	//bypasses the table, for geometry that is never meant to be shared like water sheets
+	uint32_t AddUniqueVertex(const glm::vec3 &v);
+	void AddIndex(uint32_t idx) { indices.push_back(idx); }
+
+	//appends another mesh's faces in order, sharing verts with what is already here. Partitions built
+	//with AddFace and merged in order give exactly the buffers a single pass would have
+	void Merge(const DedupMesh &other);
+
+	const std::vector<glm::vec3> &GetVerts() const { return verts; }
+	const std::vector<uint32_t> &GetIndices() const { return indices; }
+private:
+	uint32_t AddVertex(const glm::vec3 &v);
+	void ReserveTable(size_t vert_count);
+	void Rehash(size_t capacity);
+
+	std::vector<glm::vec3> verts;
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> table;
+	size_t hashed;
+};
+
+#endif
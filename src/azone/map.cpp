@@ -1,10 +1,19 @@
 #include "map.h"
-#include <sstream>
+#include "binary_writer.h"
 #include <fstream>
 #include "compression.h"
+#include "zone_map.h"
 #include "log_macros.h"
+#include "thread_pool.h"
+#include "affine_transform.h"
+#include "wld_fragment_index.h"
+#include <algorithm>
+#include <atomic>
 #include <glm/gtc/matrix_transform.hpp>
 
+//uncompressed bytes per independently deflated chunk of a chunked v2 payload
+#define MAP_PAYLOAD_CHUNK_SIZE (256 * 1024)
+
 Map::Map() {
 }
 
@@ -51,28 +60,36 @@ bool Map::Build(std::string zone_name, bool ignore_collide_tex) {
 	return CompileS3D(zone_frags, zone_object_frags, object_frags, ignore_collide_tex);
 }
 
-bool Map::Write(std::string filename) {
+void Map::OptimizeCollision(float tolerance, CollisionOptimizeStats &stats) {
+	std::vector<uint32_t> indices;
+	OptimizeCollisionMesh(collide_mesh.GetVerts(), collide_mesh.GetIndices(), tolerance, indices, stats);
+
+	//rebuilt so verts no triangle uses anymore are dropped
+	auto &verts = collide_mesh.GetVerts();
+	DedupMesh optimized;
+	optimized.Reserve(verts.size());
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		optimized.AddFace(verts[indices[i]], verts[indices[i + 1]], verts[indices[i + 2]]);
+	}
+	collide_mesh = std::move(optimized);
+
+	eqLogMessage(LogInfo, "Optimized collision mesh from %llu to %llu triangles (%llu degenerate, %llu duplicate, %llu merged).",
+		(unsigned long long)stats.triangles_before, (unsigned long long)stats.triangles_after, (unsigned long long)stats.degenerates,
+		(unsigned long long)stats.duplicates, (unsigned long long)stats.merged);
+}
+
+bool Map::Write(std::string filename, const MapWriteOptions &opts) {
+	auto &collide_verts = collide_mesh.GetVerts();
+	auto &collide_indices = collide_mesh.GetIndices();
+	auto &non_collide_verts = non_collide_mesh.GetVerts();
+	auto &non_collide_indices = non_collide_mesh.GetIndices();
+
 	//if there are no verts and no terrain
 	if ((collide_verts.size() == 0 && collide_indices.size() == 0 && non_collide_verts.size() == 0 && non_collide_indices.size() == 0) && !terrain) {
 		eqLogMessage(LogError, "Failed to write %s because the map to build has no information to write.", filename.c_str());
 		return false;
 	}
 
-	FILE *f = fopen(filename.c_str(), "wb");
-
-	if(!f) {
-		eqLogMessage(LogError, "Failed to write %s because the file could not be opened to write.", filename.c_str());
-		return false;
-	}
-	
-	uint32_t version = 0x02000000;
-	if (fwrite(&version, sizeof(uint32_t), 1, f) != 1) {
-		eqLogMessage(LogError, "Failed to write %s because the version header could not be written.", filename.c_str());
-		fclose(f);
-		return false;
-	}
-	
-	std::stringstream ss(std::stringstream::in | std::stringstream::out | std::stringstream::binary);
 	uint32_t collide_vert_count = (uint32_t)collide_verts.size();
 	uint32_t collide_ind_count = (uint32_t)collide_indices.size();
 	uint32_t non_collide_vert_count = (uint32_t)non_collide_verts.size();
@@ -83,52 +100,29 @@ bool Map::Write(std::string filename) {
 	uint32_t tile_count = terrain ? (uint32_t)terrain->GetTiles().size() : 0;
 	uint32_t quads_per_tile = terrain ? terrain->GetQuadsPerTile() : 0;
 	float units_per_vertex = terrain ? terrain->GetUnitsPerVertex() : 0.0f;
-	
-	ss.write((const char*)&collide_vert_count, sizeof(uint32_t));
-	ss.write((const char*)&collide_ind_count, sizeof(uint32_t));
-	ss.write((const char*)&non_collide_vert_count, sizeof(uint32_t));
-	ss.write((const char*)&non_collide_ind_count, sizeof(uint32_t));
-	ss.write((const char*)&model_count, sizeof(uint32_t));
-	ss.write((const char*)&plac_count, sizeof(uint32_t));
-	ss.write((const char*)&plac_group_count, sizeof(uint32_t));
-	ss.write((const char*)&tile_count, sizeof(uint32_t));
-	ss.write((const char*)&quads_per_tile, sizeof(uint32_t));
-	ss.write((const char*)&units_per_vertex, sizeof(float));
-
-	for(uint32_t i = 0; i < collide_vert_count; ++i) {
-		auto vert = collide_verts[i];
-	
-		ss.write((const char*)&vert.x, sizeof(float));
-		ss.write((const char*)&vert.y, sizeof(float));
-		ss.write((const char*)&vert.z, sizeof(float));
-	}
-	
-	for (uint32_t i = 0; i < collide_ind_count; ++i) {
-		uint32_t ind = collide_indices[i];
-	
-		ss.write((const char*)&ind, sizeof(uint32_t));
-	}
-	
-	for(uint32_t i = 0; i < non_collide_vert_count; ++i) {
-		auto vert = non_collide_verts[i];
-	
-		ss.write((const char*)&vert.x, sizeof(float));
-		ss.write((const char*)&vert.y, sizeof(float));
-		ss.write((const char*)&vert.z, sizeof(float));
-	}
-	
-	for (uint32_t i = 0; i < non_collide_ind_count; ++i) {
-		uint32_t ind = non_collide_indices[i];
-	
-		ss.write((const char*)&ind, sizeof(uint32_t));
-	}
+
+	BinaryWriter w;
+	w.Reserve(PayloadSize());
+
+	w.Write(collide_vert_count);
+	w.Write(collide_ind_count);
+	w.Write(non_collide_vert_count);
+	w.Write(non_collide_ind_count);
+	w.Write(model_count);
+	w.Write(plac_count);
+	w.Write(plac_group_count);
+	w.Write(tile_count);
+	w.Write(quads_per_tile);
+	w.Write(units_per_vertex);
+
+	w.WriteArray(collide_verts.data(), collide_vert_count);
+	w.WriteArray(collide_indices.data(), collide_ind_count);
+	w.WriteArray(non_collide_verts.data(), non_collide_vert_count);
+	w.WriteArray(non_collide_indices.data(), non_collide_ind_count);
 
 	auto model_iter = map_models.begin();
 	while(model_iter != map_models.end()) {
-		uint8_t null = 0;
-
-		ss.write(model_iter->second->GetName().c_str(), model_iter->second->GetName().length());
-		ss.write((const char*)&null, sizeof(uint8_t));
+		w.WriteString(model_iter->second->GetName());
 
 		auto &verts = model_iter->second->GetVertices();
 		auto &polys = model_iter->second->GetPolygons();
@@ -141,23 +135,14 @@ bool Map::Write(std::string filename) {
 			eqLogMessage(LogTrace, "Texture set for model %s with flag %u", model_iter->second->GetName().c_str(), set->GetFlags());
 		} 
 
-		ss.write((const char*)&vert_count, sizeof(uint32_t));
-		ss.write((const char*)&poly_count, sizeof(uint32_t));
+		w.Write(vert_count);
+		w.Write(poly_count);
 		for(uint32_t i = 0; i < vert_count; ++i) {
-			auto &vert = verts[i];
-			float x = vert.pos.x;
-			float y = vert.pos.y;
-			float z = vert.pos.z;
-			ss.write((const char*)&x, sizeof(float));
-			ss.write((const char*)&y, sizeof(float));
-			ss.write((const char*)&z, sizeof(float));
+			w.Write(verts[i].pos);
 		}
 
 		for (uint32_t i = 0; i < poly_count; ++i) {
 			auto &poly = polys[i];
-			uint32_t v1 = poly.verts[0];
-			uint32_t v2 = poly.verts[1];
-			uint32_t v3 = poly.verts[2];
 			uint8_t vis = poly.flags == 0x10 ? 0 : 1;
 			
 			if (poly.tex < textureSet.size()) {
@@ -168,10 +153,8 @@ bool Map::Write(std::string filename) {
 				}
 			}
 
-			ss.write((const char*)&v1, sizeof(uint32_t));
-			ss.write((const char*)&v2, sizeof(uint32_t));
-			ss.write((const char*)&v3, sizeof(uint32_t));
-			ss.write((const char*)&vis, sizeof(uint8_t));
+			w.WriteArray(poly.verts, 3);
+			w.Write(vis);
 		}
 
 		++model_iter;
@@ -179,42 +162,28 @@ bool Map::Write(std::string filename) {
 
 	auto eqg_model_iter = map_eqg_models.begin();
 	while (eqg_model_iter != map_eqg_models.end()) {
-		uint8_t null = 0;
-
-		ss.write(eqg_model_iter->second->GetName().c_str(), eqg_model_iter->second->GetName().length());
-		ss.write((const char*)&null, sizeof(uint8_t));
+		w.WriteString(eqg_model_iter->second->GetName());
 
 		auto &verts = eqg_model_iter->second->GetVertices();
 		auto &polys = eqg_model_iter->second->GetPolygons();
 		uint32_t vert_count = (uint32_t)verts.size();
 		uint32_t poly_count = (uint32_t)polys.size();
 
-		ss.write((const char*)&vert_count, sizeof(uint32_t));
-		ss.write((const char*)&poly_count, sizeof(uint32_t));
+		w.Write(vert_count);
+		w.Write(poly_count);
 		for (uint32_t i = 0; i < vert_count; ++i) {
-			auto &vert = verts[i];
-			float x = vert.pos.x;
-			float y = vert.pos.y;
-			float z = vert.pos.z;
-			ss.write((const char*)&x, sizeof(float));
-			ss.write((const char*)&y, sizeof(float));
-			ss.write((const char*)&z, sizeof(float));
+			w.Write(verts[i].pos);
 		}
 
 		for (uint32_t i = 0; i < poly_count; ++i) {
 			auto &poly = polys[i];
-			uint32_t v1 = poly.verts[0];
-			uint32_t v2 = poly.verts[1];
-			uint32_t v3 = poly.verts[2];
 
 			uint8_t vis = 1;
 			if (poly.flags & 0x01)
 				vis = 0;
 
-			ss.write((const char*)&v1, sizeof(uint32_t));
-			ss.write((const char*)&v2, sizeof(uint32_t));
-			ss.write((const char*)&v3, sizeof(uint32_t));
-			ss.write((const char*)&vis, sizeof(uint8_t));
+			w.WriteArray(poly.verts, 3);
+			w.Write(vis);
 		}
 
 		++eqg_model_iter;
@@ -222,86 +191,28 @@ bool Map::Write(std::string filename) {
 
 	for (uint32_t i = 0; i < plac_count; ++i) {
 		auto &plac = map_placeables[i];
-		uint8_t null = 0;
-		float x = plac->GetX();
-		float y = plac->GetY();
-		float z = plac->GetZ();
-		float x_rot = plac->GetRotateX();
-		float y_rot = plac->GetRotateY();
-		float z_rot = plac->GetRotateZ();
-		float x_scale = plac->GetScaleX();
-		float y_scale = plac->GetScaleY();
-		float z_scale = plac->GetScaleZ();
-
-		ss.write(plac->GetFileName().c_str(), plac->GetFileName().length());
-		ss.write((const char*)&null, sizeof(uint8_t));
-		ss.write((const char*)&x, sizeof(float));
-		ss.write((const char*)&y, sizeof(float));
-		ss.write((const char*)&z, sizeof(float));
-		ss.write((const char*)&x_rot, sizeof(float));
-		ss.write((const char*)&y_rot, sizeof(float));
-		ss.write((const char*)&z_rot, sizeof(float));
-		ss.write((const char*)&x_scale, sizeof(float));
-		ss.write((const char*)&y_scale, sizeof(float));
-		ss.write((const char*)&z_scale, sizeof(float));
+		w.WriteString(plac->GetFileName());
+		WritePlaceableTransform(w, plac);
 	}
 
 	for (uint32_t i = 0; i < plac_group_count; ++i) {
 		auto &gp = map_group_placeables[i];
-		uint8_t null = 0;
-		float x = gp->GetX();
-		float y = gp->GetY();
-		float z = gp->GetZ();
-		float x_rot = gp->GetRotationX();
-		float y_rot = gp->GetRotationY();
-		float z_rot = gp->GetRotationZ();
-		float x_scale = gp->GetScaleX();
-		float y_scale = gp->GetScaleY();
-		float z_scale = gp->GetScaleZ();
-		float x_tile = gp->GetTileX();
-		float y_tile = gp->GetTileY();
-		float z_tile = gp->GetTileZ();
-
-		ss.write((const char*)&x, sizeof(float));
-		ss.write((const char*)&y, sizeof(float));
-		ss.write((const char*)&z, sizeof(float));
-		ss.write((const char*)&x_rot, sizeof(float));
-		ss.write((const char*)&y_rot, sizeof(float));
-		ss.write((const char*)&z_rot, sizeof(float));
-		ss.write((const char*)&x_scale, sizeof(float));
-		ss.write((const char*)&y_scale, sizeof(float));
-		ss.write((const char*)&z_scale, sizeof(float));
-		ss.write((const char*)&x_tile, sizeof(float));
-		ss.write((const char*)&y_tile, sizeof(float));
-		ss.write((const char*)&z_tile, sizeof(float));
+		float group[12] = {
+			gp->GetX(), gp->GetY(), gp->GetZ(),
+			gp->GetRotationX(), gp->GetRotationY(), gp->GetRotationZ(),
+			gp->GetScaleX(), gp->GetScaleY(), gp->GetScaleZ(),
+			gp->GetTileX(), gp->GetTileY(), gp->GetTileZ()
+		};
+		w.WriteArray(group, 12);
 
 		auto &placs = gp->GetPlaceables();
 		uint32_t plac_count = (uint32_t)placs.size();
-		ss.write((const char*)&plac_count, sizeof(uint32_t));
+		w.Write(plac_count);
 		
 		for (uint32_t j = 0; j < plac_count; ++j) {
 			auto &plac = placs[j];
-			float x = plac->GetX();
-			float y = plac->GetY();
-			float z = plac->GetZ();
-			float x_rot = plac->GetRotateX();
-			float y_rot = plac->GetRotateY();
-			float z_rot = plac->GetRotateZ();
-			float x_scale = plac->GetScaleX();
-			float y_scale = plac->GetScaleY();
-			float z_scale = plac->GetScaleZ();
-
-			ss.write(plac->GetFileName().c_str(), plac->GetFileName().length());
-			ss.write((const char*)&null, sizeof(uint8_t));
-			ss.write((const char*)&x, sizeof(float));
-			ss.write((const char*)&y, sizeof(float));
-			ss.write((const char*)&z, sizeof(float));
-			ss.write((const char*)&x_rot, sizeof(float));
-			ss.write((const char*)&y_rot, sizeof(float));
-			ss.write((const char*)&z_rot, sizeof(float));
-			ss.write((const char*)&x_scale, sizeof(float));
-			ss.write((const char*)&y_scale, sizeof(float));
-			ss.write((const char*)&z_scale, sizeof(float));
+			w.WriteString(plac->GetFileName());
+			WritePlaceableTransform(w, plac);
 		}
 	}
 
@@ -310,63 +221,187 @@ bool Map::Write(std::string filename) {
 		uint32_t vert_count = ((quads_per_tile + 1) * (quads_per_tile + 1));
 		auto &tiles = terrain->GetTiles();
 		for (uint32_t i = 0; i < tile_count; ++i) {
-			if(tiles[i]->IsFlat()) {
-				bool flat = true;
-				float x = tiles[i]->GetX();
-				float y = tiles[i]->GetY();
-				float z = tiles[i]->GetFloats()[0];
-				ss.write((const char*)&flat, sizeof(bool));
-				ss.write((const char*)&x, sizeof(float));
-				ss.write((const char*)&y, sizeof(float));
-				ss.write((const char*)&z, sizeof(float));
-			} else {
-				bool flat = false;
-				float x = tiles[i]->GetX();
-				float y = tiles[i]->GetY();
-				ss.write((const char*)&flat, sizeof(bool));
-				ss.write((const char*)&x, sizeof(float));
-				ss.write((const char*)&y, sizeof(float));
-
-				auto &flags = tiles[i]->GetFlags();
-				for(uint32_t j = 0; j < quad_count; ++j) {
-					uint8_t f = flags[j];
-					ss.write((const char*)&f, sizeof(uint8_t));
-				}
+			uint8_t flat = tiles[i]->IsFlat() ? 1 : 0;
+			w.Write(flat);
+			w.Write(tiles[i]->GetX());
+			w.Write(tiles[i]->GetY());
 
-				auto &floats = tiles[i]->GetFloats();
-				for (uint32_t j = 0; j < vert_count; ++j) {
-					float f = floats[j];
-					ss.write((const char*)&f, sizeof(float));
-				}
+			if(flat) {
+				w.Write(tiles[i]->GetFloats()[0]);
+			} else {
+				w.WriteArray(tiles[i]->GetFlags().data(), quad_count);
+				w.WriteArray(tiles[i]->GetFloats().data(), vert_count);
 			}
 		}
 	}
 	
-	std::vector<char> buffer;
-	uint32_t buffer_len = (uint32_t)(ss.str().length() + 128);
-	buffer.resize(buffer_len);
+	//v3 and v4 are the v2 payload expanded by the same code that loads v2, so they always produce the same geometry
+	if (opts.version == 3 || opts.version == 4) {
+		ZoneMap baked;
+		if (!baked.LoadV2Payload(w.Data(), w.Size())) {
+			eqLogMessage(LogError, "Failed to write %s because the map data could not be baked.", filename.c_str());
+			return false;
+		}
 
-	uint32_t out_size = EQEmu::DeflateData(ss.str().c_str(), (uint32_t)ss.str().length(), &buffer[0], buffer_len);
-	if (fwrite(&out_size, sizeof(uint32_t), 1, f) != 1) {
-		eqLogMessage(LogError, "Failed to write %s because the compressed size header could not be written.", filename.c_str());
-		fclose(f);
+		bool written = opts.version == 3 ? baked.WriteV3(filename) : baked.WriteV4(filename, opts.chunk_size, opts.compression);
+		if (!written) {
+			eqLogMessage(LogError, "Failed to write %s because the baked map could not be written.", filename.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	if (opts.chunked_payload) {
+		return WriteChunkedPayload(filename, w.Data(), (uint32_t)w.Size(), opts.compression);
+	}
+
+	FILE *f = fopen(filename.c_str(), "wb");
+
+	if(!f) {
+		eqLogMessage(LogError, "Failed to write %s because the file could not be opened to write.", filename.c_str());
 		return false;
 	}
 	
-	uint32_t uncompressed_size = (uint32_t)ss.str().length();
-	if (fwrite(&uncompressed_size, sizeof(uint32_t), 1, f) != 1) {
-		eqLogMessage(LogError, "Failed to write %s because the uncompressed size header could not be written.", filename.c_str());
+	//the compressed size isn't known until the stream is done, it's filled in afterwards
+	uint32_t uncompressed_size = (uint32_t)w.Size();
+	uint32_t header[3] = { 0x02000000, 0, uncompressed_size };
+	if (fwrite(header, sizeof(header), 1, f) != 1) {
+		eqLogMessage(LogError, "Failed to write %s because the header could not be written.", filename.c_str());
 		fclose(f);
 		return false;
 	}
 
+	uint32_t out_size = EQEmu::DeflateStream(w.Data(), uncompressed_size, opts.compression, [f](const char *data, uint32_t len) {
+		return fwrite(data, len, 1, f) == 1;
+	});
+
+	if (out_size == 0) {
+		eqLogMessage(LogError, "Failed to write %s because the map data could not be compressed and written.", filename.c_str());
+		fclose(f);
+		return false;
+	}
 
-	if (fwrite(&buffer[0], out_size, 1, f) != 1) {
-		eqLogMessage(LogError, "Failed to write %s because the compressed data could not be written.", filename.c_str());
+	if (fseek(f, sizeof(uint32_t), SEEK_SET) != 0 || fwrite(&out_size, sizeof(uint32_t), 1, f) != 1) {
+		eqLogMessage(LogError, "Failed to write %s because the compressed size header could not be written.", filename.c_str());
 		fclose(f);
 		return false;
 	}
 
+	if (fclose(f) != 0) {
+		eqLogMessage(LogError, "Failed to write %s because the file could not be flushed.", filename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void Map::WritePlaceableTransform(BinaryWriter &w, const std::shared_ptr<EQEmu::Placeable> &plac) {
+	float transform[9] = {
+		plac->GetX(), plac->GetY(), plac->GetZ(),
+		plac->GetRotateX(), plac->GetRotateY(), plac->GetRotateZ(),
+		plac->GetScaleX(), plac->GetScaleY(), plac->GetScaleZ()
+	};
+	w.WriteArray(transform, 9);
+}
+
+//exact size of the v2 payload Write produces, so the writer allocates once
+size_t Map::PayloadSize() const {
+	size_t size = sizeof(uint32_t) * 9 + sizeof(float);
+	size += collide_mesh.GetVerts().size() * sizeof(glm::vec3) + collide_mesh.GetIndices().size() * sizeof(uint32_t);
+	size += non_collide_mesh.GetVerts().size() * sizeof(glm::vec3) + non_collide_mesh.GetIndices().size() * sizeof(uint32_t);
+
+	const size_t vert_size = sizeof(float) * 3;
+	const size_t poly_size = sizeof(uint32_t) * 3 + sizeof(uint8_t);
+	const size_t transform_size = sizeof(float) * 9;
+	for (auto &model : map_models) {
+		size += model.second->GetName().length() + 1 + sizeof(uint32_t) * 2;
+		size += model.second->GetVertices().size() * vert_size + model.second->GetPolygons().size() * poly_size;
+	}
+
+	for (auto &model : map_eqg_models) {
+		size += model.second->GetName().length() + 1 + sizeof(uint32_t) * 2;
+		size += model.second->GetVertices().size() * vert_size + model.second->GetPolygons().size() * poly_size;
+	}
+
+	for (auto &plac : map_placeables) {
+		size += plac->GetFileName().length() + 1 + transform_size;
+	}
+
+	for (auto &gp : map_group_placeables) {
+		size += sizeof(float) * 12 + sizeof(uint32_t);
+		for (auto &plac : gp->GetPlaceables()) {
+			size += plac->GetFileName().length() + 1 + transform_size;
+		}
+	}
+
+	if (terrain) {
+		size_t quads_per_tile = terrain->GetQuadsPerTile();
+		for (auto &tile : terrain->GetTiles()) {
+			size += sizeof(uint8_t) + sizeof(float) * 2;
+			if (tile->IsFlat()) {
+				size += sizeof(float);
+			} else {
+				size += quads_per_tile * quads_per_tile * sizeof(uint8_t) + (quads_per_tile + 1) * (quads_per_tile + 1) * sizeof(float);
+			}
+		}
+	}
+
+	return size;
+}
+
+bool Map::WriteChunkedPayload(const std::string &filename, const char *payload, uint32_t payload_size, const EQEmu::CompressionOptions &opts) {
+	uint32_t chunk_count = (payload_size + MAP_PAYLOAD_CHUNK_SIZE - 1) / MAP_PAYLOAD_CHUNK_SIZE;
+	uint32_t bound = EQEmu::DeflateBound(MAP_PAYLOAD_CHUNK_SIZE, opts);
+
+	//every chunk is its own zlib stream so they compress here, and later inflate, on separate threads
+	std::vector<char> buffer((size_t)bound * chunk_count);
+	std::vector<uint32_t> table((size_t)chunk_count * 2);
+	std::atomic<bool> failed(false);
+	EQEmu::ThreadPool::Instance().ParallelFor(chunk_count, [&](size_t i) {
+		uint32_t offset = (uint32_t)i * MAP_PAYLOAD_CHUNK_SIZE;
+		uint32_t in_size = std::min((uint32_t)MAP_PAYLOAD_CHUNK_SIZE, payload_size - offset);
+		uint32_t out_size = EQEmu::DeflateData(payload + offset, in_size, &buffer[i * bound], bound, opts);
+		if (out_size == 0) {
+			failed = true;
+		}
+
+		table[i * 2] = out_size;
+		table[i * 2 + 1] = in_size;
+	});
+
+	if (failed) {
+		eqLogMessage(LogError, "Failed to write %s because the map data could not be compressed.", filename.c_str());
+		return false;
+	}
+
+	FILE *f = fopen(filename.c_str(), "wb");
+	if (!f) {
+		eqLogMessage(LogError, "Failed to write %s because the file could not be opened to write.", filename.c_str());
+		return false;
+	}
+
+	uint32_t header[3] = { 0x02010000, chunk_count, payload_size };
+	if (fwrite(header, sizeof(header), 1, f) != 1) {
+		eqLogMessage(LogError, "Failed to write %s because the header could not be written.", filename.c_str());
+		fclose(f);
+		return false;
+	}
+
+	if (chunk_count > 0 && fwrite(&table[0], sizeof(uint32_t), table.size(), f) != table.size()) {
+		eqLogMessage(LogError, "Failed to write %s because the chunk table could not be written.", filename.c_str());
+		fclose(f);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < chunk_count; ++i) {
+		if (fwrite(&buffer[(size_t)i * bound], table[i * 2], 1, f) != 1) {
+			eqLogMessage(LogError, "Failed to write %s because the compressed data could not be written.", filename.c_str());
+			fclose(f);
+			return false;
+		}
+	}
+
 	fclose(f);
 	return true;
 }
@@ -406,7 +441,7 @@ void Map::TraverseBone(std::shared_ptr<EQEmu::S3D::SkeletonTrack::Bone> bone, gl
 	glm::vec3 pos(offset_x, offset_y, offset_z);
 	glm::vec3 rot(rot_x, rot_y, rot_z);
 
-	RotateVertex(pos, parent_rot.x, parent_rot.y, parent_rot.z);
+	EQEmu::RotateVertex(pos, parent_rot.x, parent_rot.y, parent_rot.z);
 	pos += parent_trans;
 	
 	rot += parent_rot;
@@ -441,23 +476,44 @@ bool Map::CompileS3D(
 	bool ignore_collide_tex
 	)
 {
-	collide_verts.clear();
-	collide_indices.clear();
-	non_collide_verts.clear();
-	non_collide_indices.clear();
-	current_collide_index = 0;
-	current_non_collide_index = 0;
-	collide_vert_to_index.clear();
-	non_collide_vert_to_index.clear();
+	collide_mesh.Clear();
+	non_collide_mesh.Clear();
 	map_models.clear();
 	map_eqg_models.clear();
 	map_placeables.clear();
 
+	//built once up front so resolving placeables below is a lookup per placeable instead of a scan
+	EQEmu::S3D::WLDFragmentIndex zone_index(zone_frags);
+	EQEmu::S3D::WLDFragmentIndex zone_object_index(zone_object_frags);
+	EQEmu::S3D::WLDFragmentIndex object_index(object_frags);
+
 	eqLogMessage(LogTrace, "Processing s3d zone geometry fragments.");
-	for(uint32_t i = 0; i < zone_frags.size(); ++i) {
-		if(zone_frags[i].type == 0x36) {
-			EQEmu::S3D::WLDFragment36 &frag = reinterpret_cast<EQEmu::S3D::WLDFragment36&>(zone_frags[i]);
-			auto model = frag.GetData();
+	std::vector<std::shared_ptr<EQEmu::S3D::Geometry>> zone_models;
+	size_t zone_vert_count = 0;
+	for(uint32_t i : zone_index.GetByType(0x36)) {
+		EQEmu::S3D::WLDFragment36 &frag = reinterpret_cast<EQEmu::S3D::WLDFragment36&>(zone_frags[i]);
+		zone_models.push_back(frag.GetData());
+		zone_vert_count += zone_models.back()->GetVertices().size();
+	}
+
+	//runs of fragments are deduplicated on their own threads then merged in order,
+	//which gives exactly the buffers a single pass over every fragment would
+	auto &pool = EQEmu::ThreadPool::Instance();
+	size_t partition_count = std::min(zone_models.size(), std::max((size_t)1, pool.Size()) * 4);
+	std::vector<DedupMesh> collide_parts(partition_count);
+	std::vector<DedupMesh> non_collide_parts(partition_count);
+	pool.ParallelFor(partition_count, [&](size_t p) {
+		size_t begin = zone_models.size() * p / partition_count;
+		size_t end = zone_models.size() * (p + 1) / partition_count;
+
+		size_t part_vert_count = 0;
+		for (size_t i = begin; i < end; ++i) {
+			part_vert_count += zone_models[i]->GetVertices().size();
+		}
+		collide_parts[p].Reserve(part_vert_count);
+
+		for (size_t i = begin; i < end; ++i) {
+			auto &model = zone_models[i];
 			auto &mod_polys = model->GetPolygons();
 			auto &mod_verts = model->GetVertices();
 
@@ -500,72 +556,69 @@ bool Map::CompileS3D(
 				v3.pos.y = t;
 
 				if(current_poly.flags == 0x10)
-					AddFace(v1.pos, v2.pos, v3.pos, false);
+					non_collide_parts[p].AddFace(v1.pos, v2.pos, v3.pos);
                 else {
                     if (!collide_tex || !ignore_collide_tex) {
-                        AddFace(v1.pos, v2.pos, v3.pos, true);
+                        collide_parts[p].AddFace(v1.pos, v2.pos, v3.pos);
                     }
                 }
 			}
 		}
+	});
+
+	collide_mesh.Reserve(zone_vert_count);
+	for (size_t p = 0; p < partition_count; ++p) {
+		collide_mesh.Merge(collide_parts[p]);
+		non_collide_mesh.Merge(non_collide_parts[p]);
+		collide_parts[p] = DedupMesh();
+		non_collide_parts[p] = DedupMesh();
 	}
 
 	eqLogMessage(LogTrace, "Processing zone placeable fragments.");
 	std::vector<std::pair<std::shared_ptr<EQEmu::Placeable>, std::shared_ptr<EQEmu::S3D::Geometry>>> placables;
 	std::vector<std::pair<std::shared_ptr<EQEmu::Placeable>, std::shared_ptr<EQEmu::S3D::SkeletonTrack>>> placables_skeleton;
-	for (uint32_t i = 0; i < zone_object_frags.size(); ++i) {
-		if (zone_object_frags[i].type == 0x15) {
-			EQEmu::S3D::WLDFragment15 &frag = reinterpret_cast<EQEmu::S3D::WLDFragment15&>(zone_object_frags[i]);
-			auto plac = frag.GetData();
-
-			if(!plac)
-			{
-				eqLogMessage(LogWarn, "Placeable entry was not found.");
-				continue;
-			}
+	for (uint32_t i : zone_object_index.GetByType(0x15)) {
+		EQEmu::S3D::WLDFragment15 &frag = reinterpret_cast<EQEmu::S3D::WLDFragment15&>(zone_object_frags[i]);
+		auto plac = frag.GetData();
 
-			if (ignore_placs.count(plac->GetName()) > 0) {
-				continue;
-			}
+		if(!plac)
+		{
+			eqLogMessage(LogWarn, "Placeable entry was not found.");
+			continue;
+		}
 
-			eqLogMessage(LogTrace, "Loading placeable %s", plac->GetName().c_str());
-			bool found = false;
-			for (uint32_t o = 0; o < object_frags.size(); ++o) {
-				if (object_frags[o].type == 0x14) {
-					EQEmu::S3D::WLDFragment14 &obj_frag = reinterpret_cast<EQEmu::S3D::WLDFragment14&>(object_frags[o]);
-					auto mod_ref = obj_frag.GetData();
-
-					if(mod_ref->GetName().compare(plac->GetName()) == 0) {
-						found = true;
-
-						auto &frag_refs = mod_ref->GetFrags();
-						for (uint32_t m = 0; m < frag_refs.size(); ++m) {
-							if (object_frags[frag_refs[m] - 1].type == 0x2D) {
-								EQEmu::S3D::WLDFragment2D &r_frag = reinterpret_cast<EQEmu::S3D::WLDFragment2D&>(object_frags[frag_refs[m] - 1]);
-								auto m_ref = r_frag.GetData();
-
-								EQEmu::S3D::WLDFragment36 &mod_frag = reinterpret_cast<EQEmu::S3D::WLDFragment36&>(object_frags[m_ref]);
-								auto mod = mod_frag.GetData();
-								placables.push_back(std::make_pair(plac, mod));
-							}
-							else if (object_frags[frag_refs[m] - 1].type == 0x11) {
-								EQEmu::S3D::WLDFragment11 &r_frag = reinterpret_cast<EQEmu::S3D::WLDFragment11&>(object_frags[frag_refs[m] - 1]);
-								auto s_ref = r_frag.GetData();
-
-								EQEmu::S3D::WLDFragment10 &skeleton_frag = reinterpret_cast<EQEmu::S3D::WLDFragment10&>(object_frags[s_ref]);
-								auto skele = skeleton_frag.GetData();
-								
-								placables_skeleton.push_back(std::make_pair(plac, skele));
-							}
-						}
-
-						break;
-					}
-				}
+		if (ignore_placs.count(plac->GetName()) > 0) {
+			continue;
+		}
+
+		eqLogMessage(LogTrace, "Loading placeable %s", plac->GetName().c_str());
+		int64_t o = object_index.FindActor(plac->GetName());
+		if (o < 0) {
+			eqLogMessage(LogWarn, "Could not find model for placeable %s", plac->GetName().c_str());
+			continue;
+		}
+
+		EQEmu::S3D::WLDFragment14 &obj_frag = reinterpret_cast<EQEmu::S3D::WLDFragment14&>(object_frags[o]);
+		auto mod_ref = obj_frag.GetData();
+
+		auto &frag_refs = mod_ref->GetFrags();
+		for (uint32_t m = 0; m < frag_refs.size(); ++m) {
+			if (object_frags[frag_refs[m] - 1].type == 0x2D) {
+				EQEmu::S3D::WLDFragment2D &r_frag = reinterpret_cast<EQEmu::S3D::WLDFragment2D&>(object_frags[frag_refs[m] - 1]);
+				auto m_ref = r_frag.GetData();
+
+				EQEmu::S3D::WLDFragment36 &mod_frag = reinterpret_cast<EQEmu::S3D::WLDFragment36&>(object_frags[m_ref]);
+				auto mod = mod_frag.GetData();
+				placables.push_back(std::make_pair(plac, mod));
 			}
+			else if (object_frags[frag_refs[m] - 1].type == 0x11) {
+				EQEmu::S3D::WLDFragment11 &r_frag = reinterpret_cast<EQEmu::S3D::WLDFragment11&>(object_frags[frag_refs[m] - 1]);
+				auto s_ref = r_frag.GetData();
 
-			if(!found) {
-				eqLogMessage(LogWarn, "Could not find model for placeable %s", plac->GetName().c_str());
+				EQEmu::S3D::WLDFragment10 &skeleton_frag = reinterpret_cast<EQEmu::S3D::WLDFragment10&>(object_frags[s_ref]);
+				auto skele = skeleton_frag.GetData();
+				
+				placables_skeleton.push_back(std::make_pair(plac, skele));
 			}
 		}
 	}
@@ -640,14 +693,8 @@ bool Map::CompileEQG(
 	std::vector<std::shared_ptr<EQEmu::Light>> &lights
 	)
 {
-	collide_verts.clear();
-	collide_indices.clear();
-	non_collide_verts.clear();
-	non_collide_indices.clear();
-	current_collide_index = 0;
-	current_non_collide_index = 0;
-	collide_vert_to_index.clear();
-	non_collide_vert_to_index.clear();
+	collide_mesh.Clear();
+	non_collide_mesh.Clear();
 	map_models.clear();
 	map_eqg_models.clear();
 	map_placeables.clear();
@@ -706,6 +753,7 @@ bool Map::CompileEQG(
 
 		auto &mod_polys = model->GetPolygons();
 		auto &mod_verts = model->GetVertices();
+		collide_mesh.Reserve(collide_mesh.GetVerts().size() + mod_verts.size());
 
 		for (uint32_t j = 0; j < mod_polys.size(); ++j) {
 			auto &current_poly = mod_polys[j];
@@ -738,14 +786,8 @@ bool Map::CompileEQG(
 
 bool Map::CompileEQGv4()
 {
-	collide_verts.clear();
-	collide_indices.clear();
-	non_collide_verts.clear();
-	non_collide_indices.clear();
-	current_collide_index = 0;
-	current_non_collide_index = 0;
-	collide_vert_to_index.clear();
-	non_collide_vert_to_index.clear();
+	collide_mesh.Clear();
+	non_collide_mesh.Clear();
 	map_models.clear();
 	map_eqg_models.clear();
 	map_placeables.clear();
@@ -780,35 +822,33 @@ bool Map::CompileEQGv4()
 				float QuadVertex4Y = QuadVertex3Y;
 				float QuadVertex4Z = QuadVertex1Z;
 
-				uint32_t current_vert = (uint32_t)non_collide_verts.size() + 3;
-				non_collide_verts.push_back(glm::vec3(QuadVertex1X, QuadVertex1Y, QuadVertex1Z));
-				non_collide_verts.push_back(glm::vec3(QuadVertex2X, QuadVertex2Y, QuadVertex2Z));
-				non_collide_verts.push_back(glm::vec3(QuadVertex3X, QuadVertex3Y, QuadVertex3Z));
-				non_collide_verts.push_back(glm::vec3(QuadVertex4X, QuadVertex4Y, QuadVertex4Z));
+				uint32_t current_vert = (uint32_t)non_collide_mesh.GetVerts().size() + 3;
+				non_collide_mesh.AddUniqueVertex(glm::vec3(QuadVertex1X, QuadVertex1Y, QuadVertex1Z));
+				non_collide_mesh.AddUniqueVertex(glm::vec3(QuadVertex2X, QuadVertex2Y, QuadVertex2Z));
+				non_collide_mesh.AddUniqueVertex(glm::vec3(QuadVertex3X, QuadVertex3Y, QuadVertex3Z));
+				non_collide_mesh.AddUniqueVertex(glm::vec3(QuadVertex4X, QuadVertex4Y, QuadVertex4Z));
 				
-				non_collide_indices.push_back(current_vert);
-				non_collide_indices.push_back(current_vert - 2);
-				non_collide_indices.push_back(current_vert - 1);
+				non_collide_mesh.AddIndex(current_vert);
+				non_collide_mesh.AddIndex(current_vert - 2);
+				non_collide_mesh.AddIndex(current_vert - 1);
 
-				non_collide_indices.push_back(current_vert);
-				non_collide_indices.push_back(current_vert - 3);
-				non_collide_indices.push_back(current_vert - 2);
+				non_collide_mesh.AddIndex(current_vert);
+				non_collide_mesh.AddIndex(current_vert - 3);
+				non_collide_mesh.AddIndex(current_vert - 2);
 			}
 		} else {
-			uint32_t id = (uint32_t)non_collide_verts.size();
+			uint32_t id = non_collide_mesh.AddUniqueVertex(glm::vec3(sheet->GetMinY(), sheet->GetMinX(), sheet->GetZHeight()));
+			non_collide_mesh.AddUniqueVertex(glm::vec3(sheet->GetMinY(), sheet->GetMaxX(), sheet->GetZHeight()));
+			non_collide_mesh.AddUniqueVertex(glm::vec3(sheet->GetMaxY(), sheet->GetMinX(), sheet->GetZHeight()));
+			non_collide_mesh.AddUniqueVertex(glm::vec3(sheet->GetMaxY(), sheet->GetMaxX(), sheet->GetZHeight()));
 
-			non_collide_verts.push_back(glm::vec3(sheet->GetMinY(), sheet->GetMinX(), sheet->GetZHeight()));
-			non_collide_verts.push_back(glm::vec3(sheet->GetMinY(), sheet->GetMaxX(), sheet->GetZHeight()));
-			non_collide_verts.push_back(glm::vec3(sheet->GetMaxY(), sheet->GetMinX(), sheet->GetZHeight()));
-			non_collide_verts.push_back(glm::vec3(sheet->GetMaxY(), sheet->GetMaxX(), sheet->GetZHeight()));
+			non_collide_mesh.AddIndex(id);
+			non_collide_mesh.AddIndex(id + 1);
+			non_collide_mesh.AddIndex(id + 2);
 
-			non_collide_indices.push_back(id);
-			non_collide_indices.push_back(id + 1);
-			non_collide_indices.push_back(id + 2);
-
-			non_collide_indices.push_back(id + 1);
-			non_collide_indices.push_back(id + 3);
-			non_collide_indices.push_back(id + 2);
+			non_collide_mesh.AddIndex(id + 1);
+			non_collide_mesh.AddIndex(id + 3);
+			non_collide_mesh.AddIndex(id + 2);
 		}
 	}
 
@@ -884,120 +924,9 @@ void Map::LoadIgnore(std::string zone_name)
 
 void Map::AddFace(glm::vec3 &v1, glm::vec3 &v2, glm::vec3 &v3, bool collidable) {
 	if (!collidable) {
-		std::tuple<float, float, float> tt = std::make_tuple(v1.x, v1.y, v1.z);
-		auto iter = non_collide_vert_to_index.find(tt);
-		if (iter == non_collide_vert_to_index.end()) {
-			non_collide_vert_to_index[tt] = current_non_collide_index;
-			non_collide_verts.push_back(v1);
-			non_collide_indices.push_back(current_non_collide_index);
-
-			++current_non_collide_index;
-		}
-		else {
-			uint32_t t_idx = iter->second;
-			non_collide_indices.push_back(t_idx);
-		}
-
-		tt = std::make_tuple(v2.x, v2.y, v2.z);
-		iter = non_collide_vert_to_index.find(tt);
-		if (iter == non_collide_vert_to_index.end()) {
-			non_collide_vert_to_index[tt] = current_non_collide_index;
-			non_collide_verts.push_back(v2);
-			non_collide_indices.push_back(current_non_collide_index);
-
-			++current_non_collide_index;
-		}
-		else {
-			uint32_t t_idx = iter->second;
-			non_collide_indices.push_back(t_idx);
-		}
-
-		tt = std::make_tuple(v3.x, v3.y, v3.z);
-		iter = non_collide_vert_to_index.find(tt);
-		if (iter == non_collide_vert_to_index.end()) {
-			non_collide_vert_to_index[tt] = current_non_collide_index;
-			non_collide_verts.push_back(v3);
-			non_collide_indices.push_back(current_non_collide_index);
-
-			++current_non_collide_index;
-		}
-		else {
-			uint32_t t_idx = iter->second;
-			non_collide_indices.push_back(t_idx);
-		}
+		non_collide_mesh.AddFace(v1, v2, v3);
 	}
 	else {
-		std::tuple<float, float, float> tt = std::make_tuple(v1.x, v1.y, v1.z);
-		auto iter = collide_vert_to_index.find(tt);
-		if (iter == collide_vert_to_index.end()) {
-			collide_vert_to_index[tt] = current_collide_index;
-			collide_verts.push_back(v1);
-			collide_indices.push_back(current_collide_index);
-
-			++current_collide_index;
-		}
-		else {
-			uint32_t t_idx = iter->second;
-			collide_indices.push_back(t_idx);
-		}
-
-		tt = std::make_tuple(v2.x, v2.y, v2.z);
-		iter = collide_vert_to_index.find(tt);
-		if (iter == collide_vert_to_index.end()) {
-			collide_vert_to_index[tt] = current_collide_index;
-			collide_verts.push_back(v2);
-			collide_indices.push_back(current_collide_index);
-
-			++current_collide_index;
-		}
-		else {
-			uint32_t t_idx = iter->second;
-			collide_indices.push_back(t_idx);
-		}
-
-		tt = std::make_tuple(v3.x, v3.y, v3.z);
-		iter = collide_vert_to_index.find(tt);
-		if (iter == collide_vert_to_index.end()) {
-			collide_vert_to_index[tt] = current_collide_index;
-			collide_verts.push_back(v3);
-			collide_indices.push_back(current_collide_index);
-
-			++current_collide_index;
-		}
-		else {
-			uint32_t t_idx = iter->second;
-			collide_indices.push_back(t_idx);
-		}
+		collide_mesh.AddFace(v1, v2, v3);
 	}
 }
-
-void Map::RotateVertex(glm::vec3 &v, float rx, float ry, float rz) {
-	glm::vec3 nv = v;
-
-	nv.y = (cos(rx) * v.y) - (sin(rx) * v.z);
-	nv.z = (sin(rx) * v.y) + (cos(rx) * v.z);
-
-	v = nv;
-	
-	nv.x = (cos(ry) * v.x) + (sin(ry) * v.z);
-	nv.z = -(sin(ry) * v.x) + (cos(ry) * v.z);
-
-	v = nv;
-
-	nv.x = (cos(rz) * v.x) - (sin(rz) * v.y);
-	nv.y = (sin(rz) * v.x) + (cos(rz) * v.y);
-
-	v = nv;
-}
-
-void Map::ScaleVertex(glm::vec3 &v, float sx, float sy, float sz) {
-	v.x = v.x * sx;
-	v.y = v.y * sy;
-	v.z = v.z * sz;
-}
-
-void Map::TranslateVertex(glm::vec3 &v, float tx, float ty, float tz) {
-	v.x = v.x + tx;
-	v.y = v.y + ty;
-	v.z = v.z + tz;
-}
@@ -11,6 +11,24 @@
 #include "s3d_loader.h"
 #include "eqg_loader.h"
 #include "eqg_v4_loader.h"
+#include "compression.h"
+#include "dedup_mesh.h"
+#include "collision_optimizer.h"
+
+struct MapWriteOptions
+{
+	MapWriteOptions() : version(2), chunk_size(1024.0f), chunked_payload(false) { }
+
+	//2 is the compressed format every server reads, 3 is pre-baked and mmappable,
+	//4 is pre-baked and split into chunk_size chunks that can be loaded on demand
+	uint32_t version;
+	EQEmu::CompressionOptions compression;
+	float chunk_size;
+	//v2 payload deflated as independent chunks so it compresses and inflates in parallel
+	bool chunked_payload;
+};
+
+class BinaryWriter;
 
 class Map
 {
@@ -19,8 +37,16 @@ public:
 	~Map();
 	
 	bool Build(std::string zone_name, bool ignore_collide_tex);
-	bool Write(std::string filename);
+	bool Write(std::string filename, const MapWriteOptions &opts);
+	//optional pass after Build, see OptimizeCollisionMesh
+	void OptimizeCollision(float tolerance, CollisionOptimizeStats &stats);
+
+	size_t GetCollidableTriangleCount() const { return collide_mesh.GetIndices().size() / 3; }
+	size_t GetNonCollidableTriangleCount() const { return non_collide_mesh.GetIndices().size() / 3; }
 private:
+	size_t PayloadSize() const;
+	static void WritePlaceableTransform(BinaryWriter &w, const std::shared_ptr<EQEmu::Placeable> &plac);
+	bool WriteChunkedPayload(const std::string &filename, const char *payload, uint32_t payload_size, const EQEmu::CompressionOptions &opts);
 	void TraverseBone(std::shared_ptr<EQEmu::S3D::SkeletonTrack::Bone> bone, glm::vec3 parent_trans, glm::vec3 parent_rot, glm::vec3 parent_scale);
 
 	bool CompileS3D(
@@ -40,21 +66,8 @@ private:
 
 	void AddFace(glm::vec3 &v1, glm::vec3 &v2, glm::vec3 &v3, bool collidable);
 
-	void RotateVertex(glm::vec3 &v, float rx, float ry, float rz);
-	void ScaleVertex(glm::vec3 &v, float sx, float sy, float sz);
-	void TranslateVertex(glm::vec3 &v, float tx, float ty, float tz);
-
-	std::vector<glm::vec3> collide_verts;
-	std::vector<uint32_t> collide_indices;
-
-	std::vector<glm::vec3> non_collide_verts;
-	std::vector<uint32_t> non_collide_indices;
-
-	uint32_t current_collide_index;
-	uint32_t current_non_collide_index;
-
-	std::map<std::tuple<float, float, float>, uint32_t> collide_vert_to_index;
-	std::map<std::tuple<float, float, float>, uint32_t> non_collide_vert_to_index;
+	DedupMesh collide_mesh;
+	DedupMesh non_collide_mesh;
 
 	std::shared_ptr<EQEmu::EQG::Terrain> terrain;
 	std::map<std::string, std::shared_ptr<EQEmu::S3D::Geometry>> map_models;
@@ -0,0 +1,139 @@
+#include "affine_transform.h"
+#include <math.h>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EQEMU_TRANSFORM_SSE
+#include <emmintrin.h>
+#endif
+
+static_assert(sizeof(glm::vec3) == sizeof(float) * 3, "vertex arrays are treated as packed floats");
+
+EQEmu::AffineTransform::AffineTransform() {
+	for (int r = 0; r < 3; ++r) {
+		for (int c = 0; c < 4; ++c) {
+			m[r][c] = r == c ? 1.0 : 0.0;
+		}
+	}
+}
+
+void EQEmu::AffineTransform::Rotate(float rx, float ry, float rz) {
+	RotateRows(1, 2, rx, false);
+	RotateRows(0, 2, ry, true);
+	RotateRows(0, 1, rz, false);
+}
+
+void EQEmu::AffineTransform::Scale(float sx, float sy, float sz) {
+	const double s[3] = { sx, sy, sz };
+	for (int r = 0; r < 3; ++r) {
+		for (int c = 0; c < 4; ++c) {
+			m[r][c] *= s[r];
+		}
+	}
+}
+
+void EQEmu::AffineTransform::Translate(float tx, float ty, float tz) {
+	m[0][3] += tx;
+	m[1][3] += ty;
+	m[2][3] += tz;
+}
+
+void EQEmu::AffineTransform::SwapAxes(int a, int b) {
+	for (int c = 0; c < 4; ++c) {
+		std::swap(m[a][c], m[b][c]);
+	}
+}
+
+glm::mat4x3 EQEmu::AffineTransform::GetMatrix() const {
+	glm::mat4x3 out;
+	for (int c = 0; c < 4; ++c) {
+		for (int r = 0; r < 3; ++r) {
+			out[c][r] = (float)m[r][c];
+		}
+	}
+	return out;
+}
+
+//rotation about y runs the other way round, see RotateVertex
+void EQEmu::AffineTransform::RotateRows(int a, int b, double angle, bool flip) {
+	double c = cos(angle);
+	double s = sin(angle);
+	if (flip) {
+		s = -s;
+	}
+
+	for (int col = 0; col < 4; ++col) {
+		double va = m[a][col];
+		double vb = m[b][col];
+		m[a][col] = c * va - s * vb;
+		m[b][col] = s * va + c * vb;
+	}
+}
+
+void EQEmu::RotateVertex(glm::vec3 &v, float rx, float ry, float rz) {
+	glm::vec3 nv = v;
+
+	nv.y = (cos(rx) * v.y) - (sin(rx) * v.z);
+	nv.z = (sin(rx) * v.y) + (cos(rx) * v.z);
+
+	v = nv;
+
+	nv.x = (cos(ry) * v.x) + (sin(ry) * v.z);
+	nv.z = -(sin(ry) * v.x) + (cos(ry) * v.z);
+
+	v = nv;
+
+	nv.x = (cos(rz) * v.x) - (sin(rz) * v.y);
+	nv.y = (sin(rz) * v.x) + (cos(rz) * v.y);
+
+	v = nv;
+}
+
+void EQEmu::ScaleVertex(glm::vec3 &v, float sx, float sy, float sz) {
+	v.x = v.x * sx;
+	v.y = v.y * sy;
+	v.z = v.z * sz;
+}
+
+void EQEmu::TranslateVertex(glm::vec3 &v, float tx, float ty, float tz) {
+	v.x = v.x + tx;
+	v.y = v.y + ty;
+	v.z = v.z + tz;
+}
+
+void EQEmu::TransformVerticesScalar(const glm::mat4x3 &m, const glm::vec3 *in, glm::vec3 *out, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		out[i] = TransformVertex(m, in[i]);
+	}
+}
+
+void EQEmu::TransformVertices(const glm::mat4x3 &m, const glm::vec3 *in, glm::vec3 *out, size_t count) {
+	size_t i = 0;
+#ifdef EQEMU_TRANSFORM_SSE
+	//four verts are three registers of packed xyz, shuffled to one register per axis and back
+	const __m128 m00 = _mm_set1_ps(m[0][0]), m10 = _mm_set1_ps(m[1][0]), m20 = _mm_set1_ps(m[2][0]), m30 = _mm_set1_ps(m[3][0]);
+	const __m128 m01 = _mm_set1_ps(m[0][1]), m11 = _mm_set1_ps(m[1][1]), m21 = _mm_set1_ps(m[2][1]), m31 = _mm_set1_ps(m[3][1]);
+	const __m128 m02 = _mm_set1_ps(m[0][2]), m12 = _mm_set1_ps(m[1][2]), m22 = _mm_set1_ps(m[2][2]), m32 = _mm_set1_ps(m[3][2]);
+	for (; i + 4 <= count; i += 4) {
+		const float *src = (const float*)&in[i];
+		__m128 a = _mm_loadu_ps(src);
+		__m128 b = _mm_loadu_ps(src + 4);
+		__m128 c = _mm_loadu_ps(src + 8);
+
+		__m128 x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+		__m128 ox = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m10, y)), _mm_mul_ps(m20, z)), m30);
+		__m128 oy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, x), _mm_mul_ps(m11, y)), _mm_mul_ps(m21, z)), m31);
+		__m128 oz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, x), _mm_mul_ps(m12, y)), _mm_mul_ps(m22, z)), m32);
+
+		float *dst = (float*)&out[i];
+		_mm_storeu_ps(dst, _mm_shuffle_ps(_mm_shuffle_ps(ox, oy, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(oz, ox, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(dst + 4, _mm_shuffle_ps(_mm_shuffle_ps(oy, oz, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(ox, oy, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(dst + 8, _mm_shuffle_ps(_mm_shuffle_ps(oz, ox, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(oy, oz, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+	}
+#endif
+
+	TransformVerticesScalar(m, in + i, out + i, count - i);
+}
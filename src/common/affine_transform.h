@@ -0,0 +1,51 @@
+#ifndef EQEMU_COMMON_AFFINE_TRANSFORM_H
+#define EQEMU_COMMON_AFFINE_TRANSFORM_H
+
+#include <stddef.h>
+#include <glm/glm.hpp>
+
+namespace EQEmu
+{
+
+//A placement's rotate/scale/translate steps composed into one 3x4 matrix. Each step applies to the
+//result of the ones before it, exactly like running them on every vertex, but the trig is done once.
+//Composed in double so a large translation doesn't cost the model its precision
+class AffineTransform
+{
+public:
+	AffineTransform();
+
+	//x then y then z, the same as RotateVertex
+	void Rotate(float rx, float ry, float rz);
+	void Scale(float sx, float sy, float sz);
+	void Translate(float tx, float ty, float tz);
+	void SwapAxes(int a, int b);
+
+	glm::mat4x3 GetMatrix() const;
+private:
+	void RotateRows(int a, int b, double angle, bool flip);
+
+	double m[3][4];
+};
+
+//per vertex versions of the steps above
+void RotateVertex(glm::vec3 &v, float rx, float ry, float rz);
+void ScaleVertex(glm::vec3 &v, float sx, float sy, float sz);
+void TranslateVertex(glm::vec3 &v, float tx, float ty, float tz);
+
+//m * v with the multiplies and adds in the same order as the batch kernels
+inline glm::vec3 TransformVertex(const glm::mat4x3 &m, const glm::vec3 &v) {
+	return glm::vec3(
+		m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z + m[3][0],
+		m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z + m[3][1],
+		m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z + m[3][2]);
+}
+
+//out[i] = m * in[i], in and out may be the same array. Uses SSE where the target has it, four verts at
+//a time, and the scalar version otherwise; both give bit identical results
+void TransformVertices(const glm::mat4x3 &m, const glm::vec3 *in, glm::vec3 *out, size_t count);
+void TransformVerticesScalar(const glm::mat4x3 &m, const glm::vec3 *in, glm::vec3 *out, size_t count);
+
+}
+
+#endif
@@ -0,0 +1,154 @@
+#include "build_manifest.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+
+#define MANIFEST_HEADER "# eqemu build manifest v1"
+#define MANIFEST_READ_BLOCK (1024 * 1024)
+
+//64 bit FNV-1a, used to fold the per input values together
+static uint64_t HashBytes(const void *data, size_t len, uint64_t h) {
+	const unsigned char *p = (const unsigned char*)data;
+	for (size_t i = 0; i < len; ++i) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+//crc32 and adler32 of the whole file, zlib already does both at memory speed
+static bool HashFile(const std::string &filename, uint64_t &size, uint32_t &crc, uint32_t &adler) {
+	FILE *f = fopen(filename.c_str(), "rb");
+	if (!f) {
+		return false;
+	}
+
+	std::vector<unsigned char> buffer(MANIFEST_READ_BLOCK);
+	size = 0;
+	crc = crc32(0L, Z_NULL, 0);
+	adler = adler32(0L, Z_NULL, 0);
+	for (;;) {
+		size_t n = fread(&buffer[0], 1, buffer.size(), f);
+		if (n == 0) {
+			break;
+		}
+
+		crc = crc32(crc, &buffer[0], (uInt)n);
+		adler = adler32(adler, &buffer[0], (uInt)n);
+		size += n;
+	}
+
+	bool ok = ferror(f) == 0;
+	fclose(f);
+	return ok;
+}
+
+bool EQEmu::BuildManifest::Load(const std::string &filename) {
+	std::lock_guard<std::mutex> guard(lock);
+	entries.clear();
+
+	FILE *f = fopen(filename.c_str(), "rb");
+	if (!f) {
+		return false;
+	}
+
+	char line[1024];
+	if (!fgets(line, sizeof(line), f) || strncmp(line, MANIFEST_HEADER, strlen(MANIFEST_HEADER)) != 0) {
+		fclose(f);
+		return false;
+	}
+
+	//<hash> <name>
+	while (fgets(line, sizeof(line), f)) {
+		size_t len = strlen(line);
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+			line[--len] = 0;
+		}
+
+		char *sep = strchr(line, ' ');
+		if (!sep || sep == line || sep[1] == 0) {
+			continue;
+		}
+
+		*sep = 0;
+		entries[sep + 1] = line;
+	}
+
+	fclose(f);
+	return true;
+}
+
+bool EQEmu::BuildManifest::Save(const std::string &filename) const {
+	std::lock_guard<std::mutex> guard(lock);
+
+	//written to the side then moved over so an interrupted run never leaves a half written manifest
+	std::string temp = filename + ".tmp";
+	FILE *f = fopen(temp.c_str(), "wb");
+	if (!f) {
+		return false;
+	}
+
+	bool ok = fprintf(f, "%s\n", MANIFEST_HEADER) > 0;
+	for (auto &entry : entries) {
+		if (fprintf(f, "%s %s\n", entry.second.c_str(), entry.first.c_str()) < 0) {
+			ok = false;
+		}
+	}
+
+	if (fclose(f) != 0) {
+		ok = false;
+	}
+
+	if (!ok) {
+		remove(temp.c_str());
+		return false;
+	}
+
+	remove(filename.c_str());
+	return rename(temp.c_str(), filename.c_str()) == 0;
+}
+
+std::string EQEmu::BuildManifest::Hash(const std::string &settings, const std::vector<std::string> &inputs) {
+	uint64_t h = 14695981039346656037ULL;
+	h = HashBytes(settings.c_str(), settings.length() + 1, h);
+
+	for (auto &input : inputs) {
+		h = HashBytes(input.c_str(), input.length() + 1, h);
+
+		uint64_t size;
+		uint32_t crc;
+		uint32_t adler;
+		if (HashFile(input, size, crc, adler)) {
+			uint8_t present = 1;
+			h = HashBytes(&present, sizeof(present), h);
+			h = HashBytes(&size, sizeof(size), h);
+			h = HashBytes(&crc, sizeof(crc), h);
+			h = HashBytes(&adler, sizeof(adler), h);
+		} else {
+			uint8_t present = 0;
+			h = HashBytes(&present, sizeof(present), h);
+		}
+	}
+
+	char out[17];
+	snprintf(out, sizeof(out), "%016llx", (unsigned long long)h);
+	return out;
+}
+
+bool EQEmu::BuildManifest::IsCurrent(const std::string &name, const std::string &hash) const {
+	std::lock_guard<std::mutex> guard(lock);
+	auto iter = entries.find(name);
+	return iter != entries.end() && iter->second == hash;
+}
+
+void EQEmu::BuildManifest::Set(const std::string &name, const std::string &hash) {
+	std::lock_guard<std::mutex> guard(lock);
+	entries[name] = hash;
+}
+
+void EQEmu::BuildManifest::Remove(const std::string &name) {
+	std::lock_guard<std::mutex> guard(lock);
+	entries.erase(name);
+}
@@ -0,0 +1,41 @@
+#ifndef EQEMU_COMMON_BUILD_MANIFEST_H
+#define EQEMU_COMMON_BUILD_MANIFEST_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+namespace EQEmu
+{
+
+//Remembers a hash of everything that went into each output so a tool can skip outputs whose inputs
+//haven't changed. Entries can be checked and set from any thread, saving is done once at the end
+class BuildManifest
+{
+public:
+	BuildManifest() { }
+	~BuildManifest() { }
+
+	//a missing or unreadable manifest just means everything gets rebuilt
+	bool Load(const std::string &filename);
+	bool Save(const std::string &filename) const;
+
+	//hashes the settings string (tool version and flags) with the name, size and contents of every input,
+	//a missing input hashes differently from an empty one so files appearing or vanishing are noticed
+	static std::string Hash(const std::string &settings, const std::vector<std::string> &inputs);
+
+	bool IsCurrent(const std::string &name, const std::string &hash) const;
+	void Set(const std::string &name, const std::string &hash);
+	void Remove(const std::string &name);
+private:
+	BuildManifest(const BuildManifest &s);
+	const BuildManifest &operator=(const BuildManifest &s);
+
+	std::map<std::string, std::string> entries;
+	mutable std::mutex lock;
+};
+
+}
+
+#endif
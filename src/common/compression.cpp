@@ -1,65 +1,165 @@
 #include "compression.h"
 #include <zlib.h>
 #include <string.h>
+#include <vector>
+
+#define DEFLATE_STREAM_CHUNK (256 * 1024)
+
+namespace
+{
+
+//deflate streams are kept per thread and only rebuilt when the settings change
+struct DeflateContext
+{
+	DeflateContext() {
+		memset(&zstream, 0, sizeof(zstream));
+		zstream.zalloc = Z_NULL;
+		zstream.zfree = Z_NULL;
+		zstream.opaque = Z_NULL;
+		initialized = false;
+	}
+
+	~DeflateContext() {
+		if (initialized) {
+			deflateEnd(&zstream);
+		}
+	}
+
+	bool Prepare(const EQEmu::CompressionOptions &opts) {
+		if (initialized && opts == current) {
+			return deflateReset(&zstream) == Z_OK;
+		}
+
+		if (initialized) {
+			deflateEnd(&zstream);
+			initialized = false;
+		}
+
+		if (deflateInit2(&zstream, opts.level, Z_DEFLATED, opts.window_bits, opts.mem_level, opts.strategy) != Z_OK) {
+			return false;
+		}
+
+		current = opts;
+		initialized = true;
+		return true;
+	}
 
-uint32_t EQEmu::DeflateData(const char *buffer, uint32_t len, char *out_buffer, uint32_t out_len_max) {
 	z_stream zstream;
-	memset(&zstream, 0, sizeof(zstream));
-	int zerror;
+	EQEmu::CompressionOptions current;
+	bool initialized;
+};
+
+DeflateContext &LocalDeflateContext() {
+	thread_local DeflateContext ctx;
+	return ctx;
+}
+
+//inflate streams are reused per thread, resetting is far cheaper than a full init/end cycle
+struct InflateContext
+{
+	InflateContext() {
+		memset(&zstream, 0, sizeof(zstream));
+		zstream.zalloc = Z_NULL;
+		zstream.zfree = Z_NULL;
+		zstream.opaque = Z_NULL;
+		initialized = inflateInit2(&zstream, 15) == Z_OK;
+	}
+
+	~InflateContext() {
+		if (initialized) {
+			inflateEnd(&zstream);
+		}
+	}
+
+	z_stream zstream;
+	bool initialized;
+};
+
+}
+
+uint32_t EQEmu::InflateData(const char* buffer, uint32_t len, char* out_buffer, uint32_t out_len_max) {
+	thread_local InflateContext ctx;
+	if (!ctx.initialized) {
+		return 0;
+	}
+
+	z_stream &zstream = ctx.zstream;
+	if (inflateReset(&zstream) != Z_OK) {
+		return 0;
+	}
 
 	zstream.next_in = const_cast<unsigned char*>(reinterpret_cast<const unsigned char*>(buffer));
 	zstream.avail_in = len;
-	zstream.zalloc = Z_NULL;
-	zstream.zfree = Z_NULL;
-	zstream.opaque = Z_NULL;
-	deflateInit(&zstream, Z_FINISH);
-
 	zstream.next_out = reinterpret_cast<unsigned char*>(out_buffer);
 	zstream.avail_out = out_len_max;
-	zerror = deflate(&zstream, Z_FINISH);
 
-	if (zerror == Z_STREAM_END)
-	{
-		deflateEnd(&zstream);
+	int zerror = inflate(&zstream, Z_FINISH);
+	if (zerror == Z_STREAM_END) {
 		return (uint32_t)zstream.total_out;
 	}
-	else
-	{
-		zerror = deflateEnd(&zstream);
-		return 0;
-	}
+
+	return 0;
 }
 
-uint32_t EQEmu::InflateData(const char* buffer, uint32_t len, char* out_buffer, uint32_t out_len_max) {
-	z_stream zstream;
-	int zerror = 0;
-	int i;
+uint32_t EQEmu::DeflateData(const char *buffer, uint32_t len, char *out_buffer, uint32_t out_len_max) {
+	return DeflateData(buffer, len, out_buffer, out_len_max, CompressionOptions());
+}
 
+uint32_t EQEmu::DeflateData(const char *buffer, uint32_t len, char *out_buffer, uint32_t out_len_max, const CompressionOptions &opts) {
+	DeflateContext &ctx = LocalDeflateContext();
+	if (!ctx.Prepare(opts)) {
+		return 0;
+	}
+
+	z_stream &zstream = ctx.zstream;
 	zstream.next_in = const_cast<unsigned char*>(reinterpret_cast<const unsigned char*>(buffer));
 	zstream.avail_in = len;
-	zstream.next_out = reinterpret_cast<unsigned char*>(out_buffer);;
+	zstream.next_out = reinterpret_cast<unsigned char*>(out_buffer);
 	zstream.avail_out = out_len_max;
-	zstream.zalloc = Z_NULL;
-	zstream.zfree = Z_NULL;
-	zstream.opaque = Z_NULL;
 
-	i = inflateInit2(&zstream, 15);
-	if (i != Z_OK) {
-		return 0;
+	int zerror = deflate(&zstream, Z_FINISH);
+	if (zerror == Z_STREAM_END) {
+		return (uint32_t)zstream.total_out;
 	}
 
-	zerror = inflate(&zstream, Z_FINISH);
-	if (zerror == Z_STREAM_END) {
-		inflateEnd(&zstream);
-		return zstream.total_out;
+	return 0;
+}
+
+uint32_t EQEmu::DeflateBound(uint32_t len, const CompressionOptions &opts) {
+	DeflateContext &ctx = LocalDeflateContext();
+	if (!ctx.Prepare(opts)) {
+		return (uint32_t)compressBound(len);
 	}
-	else {
-		if (zerror == -4 && zstream.msg == 0)
-		{
-			return 0;
-		}
 
-		zerror = inflateEnd(&zstream);
+	return (uint32_t)deflateBound(&ctx.zstream, len);
+}
+
+uint32_t EQEmu::DeflateStream(const char *buffer, uint32_t len, const CompressionOptions &opts, const std::function<bool(const char*, uint32_t)> &sink) {
+	DeflateContext &ctx = LocalDeflateContext();
+	if (!ctx.Prepare(opts)) {
 		return 0;
 	}
+
+	std::vector<char> out(DEFLATE_STREAM_CHUNK);
+	z_stream &zstream = ctx.zstream;
+	zstream.next_in = const_cast<unsigned char*>(reinterpret_cast<const unsigned char*>(buffer));
+	zstream.avail_in = len;
+
+	int zerror;
+	do {
+		zstream.next_out = reinterpret_cast<unsigned char*>(&out[0]);
+		zstream.avail_out = (uInt)out.size();
+
+		zerror = deflate(&zstream, Z_FINISH);
+		if (zerror != Z_OK && zerror != Z_STREAM_END) {
+			return 0;
+		}
+
+		uint32_t have = (uint32_t)out.size() - zstream.avail_out;
+		if (have > 0 && !sink(&out[0], have)) {
+			return 0;
+		}
+	} while (zerror != Z_STREAM_END);
+
+	return (uint32_t)zstream.total_out;
 }
@@ -2,13 +2,38 @@
 #define EQEMU_COMMON_COMPRESSION_H
 
 #include <stdint.h>
+#include <functional>
 
 namespace EQEmu
 {
 
+//Deflate settings, values map straight onto zlib's deflateInit2 arguments
+struct CompressionOptions
+{
+	//level 4 is what every file we've ever written was compressed with, keep it unless told otherwise
+	CompressionOptions() : level(4), strategy(0), window_bits(15), mem_level(8) { }
+	CompressionOptions(int l, int s = 0, int w = 15, int m = 8) : level(l), strategy(s), window_bits(w), mem_level(m) { }
+
+	bool operator==(const CompressionOptions &o) const {
+		return level == o.level && strategy == o.strategy && window_bits == o.window_bits && mem_level == o.mem_level;
+	}
+
+	bool operator!=(const CompressionOptions &o) const { return !(*this == o); }
+
+	int level; //0-9, -1 is zlib's default
+	int strategy; //Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE or Z_FIXED
+	int window_bits; //9-15
+	int mem_level; //1-9
+};
+
 uint32_t DeflateData(const char *buffer, uint32_t len, char *out_buffer, uint32_t out_len_max);
+uint32_t DeflateData(const char *buffer, uint32_t len, char *out_buffer, uint32_t out_len_max, const CompressionOptions &opts);
+uint32_t DeflateBound(uint32_t len, const CompressionOptions &opts);
+//same stream DeflateData makes, handed to sink a piece at a time so no DeflateBound sized buffer is needed.
+//Returns the compressed size, 0 if deflate fails or sink returns false
+uint32_t DeflateStream(const char *buffer, uint32_t len, const CompressionOptions &opts, const std::function<bool(const char*, uint32_t)> &sink);
 uint32_t InflateData(const char* buffer, uint32_t len, char* out_buffer, uint32_t out_len_max);
 
 }
 
-#endif
\ No newline at end of file
+#endif
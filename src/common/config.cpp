@@ -1,6 +1,8 @@
 #include "config.h"
+#include "log_macros.h"
 #include <nlohmann/json.hpp>
 #include <fstream>
+#include <zlib.h>
 
 using json = nlohmann::json;
 
@@ -34,3 +36,69 @@ const std::string Config::GetPath(const std::string &type, const std::string &de
 	
 	return defaultValue;
 }
+
+//out of range values are ignored with a warning, zlib would either refuse them or (window_bits outside 9..15)
+//write a gzip or raw stream that InflateData can't read back
+static void GetCompressionField(json &opts, const std::string &type, const char *name, int min, int max, int &out) {
+	auto value = opts[name];
+	if (!value.is_number_integer()) {
+		return;
+	}
+
+	int64_t v = value;
+	if (v < min || v > max) {
+		eqLogMessage(LogWarn, "Ignoring compression %s %s of %lld, it must be from %d to %d.", type.c_str(), name, (long long)v, min, max);
+		return;
+	}
+
+	out = (int)v;
+}
+
+const EQEmu::CompressionOptions Config::GetCompression(const std::string &type, const EQEmu::CompressionOptions &defaultValue) {
+	EQEmu::CompressionOptions ret = defaultValue;
+	auto compression = mImpl->obj["compression"];
+	if (!compression.is_object()) {
+		return ret;
+	}
+
+	auto opts = compression[type];
+	if (!opts.is_object()) {
+		return ret;
+	}
+
+	GetCompressionField(opts, type, "level", -1, 9, ret.level);
+
+	auto strategy = opts["strategy"];
+	if (strategy.is_number_integer()) {
+		GetCompressionField(opts, type, "strategy", Z_DEFAULT_STRATEGY, Z_FIXED, ret.strategy);
+	} else if (strategy.is_string()) {
+		std::string name = strategy;
+		if (name == "default") {
+			ret.strategy = Z_DEFAULT_STRATEGY;
+		} else if (name == "filtered") {
+			ret.strategy = Z_FILTERED;
+		} else if (name == "huffman") {
+			ret.strategy = Z_HUFFMAN_ONLY;
+		} else if (name == "rle") {
+			ret.strategy = Z_RLE;
+		} else if (name == "fixed") {
+			ret.strategy = Z_FIXED;
+		} else {
+			eqLogMessage(LogWarn, "Ignoring unknown compression %s strategy %s.", type.c_str(), name.c_str());
+		}
+	}
+
+	GetCompressionField(opts, type, "window_bits", 9, 15, ret.window_bits);
+	GetCompressionField(opts, type, "mem_level", 1, 9, ret.mem_level);
+
+	return ret;
+}
+
+const float Config::GetWeldEpsilon(float defaultValue) {
+	auto weld = mImpl->obj["weld"];
+	if (weld.is_object() && weld["epsilon"].is_number()) {
+		return weld["epsilon"];
+	}
+
+	return defaultValue;
+}
@@ -2,6 +2,7 @@
 #define EQEMU_COMMON_CONFIG_H
 
 #include <string>
+#include "compression.h"
 
 class Config {
 public:
@@ -13,6 +14,8 @@ public:
 	}
 
 	const std::string GetPath(const std::string &type, const std::string &defaultValue);
+	const EQEmu::CompressionOptions GetCompression(const std::string &type, const EQEmu::CompressionOptions &defaultValue);
+	const float GetWeldEpsilon(float defaultValue);
 
 private:
 	Config();
@@ -1,25 +1,67 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <tuple>
 
 #include <btBulletDynamicsCommon.h>
 
 #include "log_macros.h"
 #include "eq_physics.h"
+#include "zone_map.h"
+#include "affine_transform.h"
 
 struct btMeshInfo
 {
+	btMeshInfo() { }
 	btMeshInfo(btTriangleMesh* mesh_in, btBvhTriangleMeshShape* mesh_shape_in, btRigidBody* rb_in) {
-		mesh.reset(mesh_in);
+		meshes.emplace_back(mesh_in);
 		mesh_shape.reset(mesh_shape_in);
 		rb.reset(rb_in);
 	}
 
-	std::unique_ptr<btTriangleMesh> mesh;
-	std::unique_ptr<btBvhTriangleMeshShape> mesh_shape;
+	//instanced entries own a bvh per model and a scaled view of it per distinct scale,
+	//mesh_shape is then the compound that places them
+	std::vector<std::unique_ptr<btTriangleMesh>> meshes;
+	std::vector<std::unique_ptr<btCollisionShape>> child_shapes;
+	std::unique_ptr<btCollisionShape> mesh_shape;
 	std::unique_ptr<btRigidBody> rb;
 };
 
+//splits an instance transform into a rotation and per axis scale, which is all a compound child
+//and btScaledBvhTriangleMeshShape can express. Sheared transforms fail and get expanded instead
+static bool DecomposeInstanceTransform(const glm::mat4x3 &transform, btMatrix3x3 &basis, btVector3 &scale) {
+	glm::vec3 axis[3] = { transform[0], transform[1], transform[2] };
+	float len[3];
+	for (int i = 0; i < 3; ++i) {
+		len[i] = glm::length(axis[i]);
+		if (len[i] < 0.00001f) {
+			return false;
+		}
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		int j = (i + 1) % 3;
+		if (fabs(glm::dot(axis[i], axis[j])) > 0.0001f * len[i] * len[j]) {
+			return false;
+		}
+	}
+
+	//mirrored placements keep a proper rotation and carry the flip in the scale
+	if (glm::dot(axis[0], glm::cross(axis[1], axis[2])) < 0.0f) {
+		len[0] = -len[0];
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		axis[i] /= len[i];
+	}
+
+	basis.setValue(axis[0].x, axis[1].x, axis[2].x,
+		axis[0].y, axis[1].y, axis[2].y,
+		axis[0].z, axis[1].z, axis[2].z);
+	scale.setValue(len[0], len[1], len[2]);
+	return true;
+}
+
 struct EQPhysics::impl {
 	std::unique_ptr<WaterMap> water_map;
 	std::unique_ptr<btBroadphaseInterface> collision_broadphase;
@@ -80,7 +122,7 @@ WaterMap *EQPhysics::GetWaterMap()
 	return imp->water_map.get();
 }
 
-void EQPhysics::RegisterMesh(const std::string &ident, const std::vector<glm::vec3>& verts, const std::vector<unsigned int>& inds, const glm::vec3 &pos, EQPhysicsFlags flag) {
+void EQPhysics::RegisterMesh(const std::string &ident, EQEmu::Span<const glm::vec3> verts, EQEmu::Span<const unsigned int> inds, const glm::vec3 &pos, EQPhysicsFlags flag) {
 	UnregisterMesh(ident);
 
 	if (verts.size() == 0 || inds.size() == 0) {
@@ -116,6 +158,99 @@ void EQPhysics::RegisterMesh(const std::string &ident, const std::vector<glm::ve
 	imp->entity_info->insert(std::make_pair(ident, btMeshInfo(mesh, mesh_shape, rb)));
 }
 
+void EQPhysics::RegisterInstances(const std::string &ident, EQEmu::Span<const EQEmu::InstancedModel> models, EQEmu::Span<const EQEmu::MeshInstance> instances, EQPhysicsFlags flag) {
+	UnregisterMesh(ident);
+
+	if (models.size() == 0 || instances.size() == 0) {
+		return;
+	}
+
+	btMeshInfo info;
+	btCompoundShape *compound = new btCompoundShape();
+	info.mesh_shape.reset(compound);
+
+	std::vector<btBvhTriangleMeshShape*> model_shapes(models.size(), nullptr);
+	std::map<std::tuple<uint32_t, float, float, float>, btCollisionShape*> scaled_shapes;
+	btTriangleMesh *expanded = nullptr;
+	for (auto &instance : instances) {
+		if (instance.model >= models.size() || models[instance.model].inds.empty()) {
+			continue;
+		}
+
+		auto &model = models[instance.model];
+		btMatrix3x3 basis;
+		btVector3 scale;
+		if (!DecomposeInstanceTransform(instance.transform, basis, scale)) {
+			if (!expanded) {
+				expanded = new btTriangleMesh();
+				info.meshes.emplace_back(expanded);
+			}
+
+			for (size_t i = 0; i + 2 < model.inds.size(); i += 3) {
+				glm::vec3 v1 = EQEmu::TransformVertex(instance.transform, model.verts[model.inds[i + 0]]);
+				glm::vec3 v2 = EQEmu::TransformVertex(instance.transform, model.verts[model.inds[i + 1]]);
+				glm::vec3 v3 = EQEmu::TransformVertex(instance.transform, model.verts[model.inds[i + 2]]);
+				expanded->addTriangle(btVector3(v1.x, v1.y, v1.z), btVector3(v2.x, v2.y, v2.z), btVector3(v3.x, v3.y, v3.z));
+			}
+			continue;
+		}
+
+		if (!model_shapes[instance.model]) {
+			btTriangleMesh *mesh = new btTriangleMesh();
+			for (size_t i = 0; i + 2 < model.inds.size(); i += 3) {
+				auto &v1 = model.verts[model.inds[i + 0]];
+				auto &v2 = model.verts[model.inds[i + 1]];
+				auto &v3 = model.verts[model.inds[i + 2]];
+				mesh->addTriangle(btVector3(v1.x, v1.y, v1.z), btVector3(v2.x, v2.y, v2.z), btVector3(v3.x, v3.y, v3.z));
+			}
+
+			info.meshes.emplace_back(mesh);
+			model_shapes[instance.model] = new btBvhTriangleMeshShape(mesh, true, true);
+			info.child_shapes.emplace_back(model_shapes[instance.model]);
+		}
+
+		btCollisionShape *shape = model_shapes[instance.model];
+		if (fabs(scale.x() - 1.0f) > 0.0001f || fabs(scale.y() - 1.0f) > 0.0001f || fabs(scale.z() - 1.0f) > 0.0001f) {
+			auto key = std::make_tuple(instance.model, (float)scale.x(), (float)scale.y(), (float)scale.z());
+			auto iter = scaled_shapes.find(key);
+			if (iter == scaled_shapes.end()) {
+				shape = new btScaledBvhTriangleMeshShape(model_shapes[instance.model], scale);
+				info.child_shapes.emplace_back(shape);
+				scaled_shapes[key] = shape;
+			}
+			else {
+				shape = iter->second;
+			}
+		}
+
+		auto &origin = instance.transform[3];
+		compound->addChildShape(btTransform(basis, btVector3(origin.x, origin.y, origin.z)), shape);
+	}
+
+	if (expanded) {
+		btBvhTriangleMeshShape *shape = new btBvhTriangleMeshShape(expanded, true, true);
+		info.child_shapes.emplace_back(shape);
+
+		btTransform identity;
+		identity.setIdentity();
+		compound->addChildShape(identity, shape);
+	}
+
+	if (compound->getNumChildShapes() == 0) {
+		return;
+	}
+
+	btTransform origin_transform;
+	origin_transform.setIdentity();
+
+	btDefaultMotionState* motionState = new btDefaultMotionState(origin_transform);
+	btRigidBody::btRigidBodyConstructionInfo rb_info(0.0f, motionState, compound, btVector3(0.0f, 0.0f, 0.0f));
+	info.rb.reset(new btRigidBody(rb_info));
+
+	imp->collision_world->addRigidBody(info.rb.get(), (short)flag, (short)flag);
+	imp->entity_info->insert(std::make_pair(ident, std::move(info)));
+}
+
 void EQPhysics::UnregisterMesh(const std::string &ident) {
 	auto iter = imp->entity_info->find(ident);
 	if (iter != imp->entity_info->end()) {
@@ -136,6 +271,53 @@ void EQPhysics::UnregisterMesh(const std::string &ident) {
 	}
 }
 
+static std::string ChunkIdent(const ZoneMap::Chunk &chunk, bool collidable) {
+	char ident[64];
+	snprintf(ident, sizeof(ident), "%sChunk%d_%d", collidable ? "Collide" : "NonCollide", chunk.grid_x, chunk.grid_y);
+	return ident;
+}
+
+void EQPhysics::AttachChunk(const ZoneMap &map, size_t idx) {
+	auto chunks = map.GetChunks();
+	if (idx >= chunks.size() || !chunks[idx].resident) {
+		return;
+	}
+
+	//a chunk's inds index the map's whole vert list, so that goes in with just the chunk's slice of inds
+	auto &chunk = chunks[idx];
+	auto inds = map.GetCollidableInds();
+	RegisterMesh(ChunkIdent(chunk, true), map.GetCollidableVerts(), EQEmu::Span<const unsigned int>(inds.data() + chunk.ind_start, chunk.ind_count),
+		glm::vec3(0.0f, 0.0f, 0.0f), EQPhysicsFlags::CollidableWorld);
+
+	auto nc_inds = map.GetNonCollidableInds();
+	RegisterMesh(ChunkIdent(chunk, false), map.GetNonCollidableVerts(), EQEmu::Span<const unsigned int>(nc_inds.data() + chunk.nc_ind_start, chunk.nc_ind_count),
+		glm::vec3(0.0f, 0.0f, 0.0f), EQPhysicsFlags::NonCollidableWorld);
+}
+
+void EQPhysics::DetachChunk(const ZoneMap &map, size_t idx) {
+	auto chunks = map.GetChunks();
+	if (idx >= chunks.size()) {
+		return;
+	}
+
+	UnregisterMesh(ChunkIdent(chunks[idx], true));
+	UnregisterMesh(ChunkIdent(chunks[idx], false));
+}
+
+void EQPhysics::SyncChunks(const ZoneMap &map) {
+	auto chunks = map.GetChunks();
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		bool attached = imp->entity_info->count(ChunkIdent(chunks[i], true)) > 0 ||
+			imp->entity_info->count(ChunkIdent(chunks[i], false)) > 0;
+		if (chunks[i].resident && !attached) {
+			AttachChunk(map, i);
+		}
+		else if (!chunks[i].resident && attached) {
+			DetachChunk(map, i);
+		}
+	}
+}
+
 void EQPhysics::MoveMesh(const std::string &ident, const glm::vec3 &pos) {
 	auto iter = imp->entity_info->find(ident);
 	if (iter != imp->entity_info->end()) {
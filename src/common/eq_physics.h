@@ -5,6 +5,8 @@
 
 #include "oriented_bounding_box.h"
 #include "water_map.h"
+#include "mesh_instance.h"
+#include "span.h"
 
 enum EQPhysicsFlags
 {
@@ -15,6 +17,7 @@ enum EQPhysicsFlags
 };
 
 class btCollisionObject;
+class ZoneMap;
 class EQPhysics
 {
 public:
@@ -24,8 +27,15 @@ public:
 	//manipulation
 	void SetWaterMap(WaterMap *w);
 	WaterMap *GetWaterMap();
-	void RegisterMesh(const std::string &ident, const std::vector<glm::vec3>& verts, const std::vector<unsigned int>& inds, const glm::vec3 &pos, EQPhysicsFlags flag);
+	void RegisterMesh(const std::string &ident, EQEmu::Span<const glm::vec3> verts, EQEmu::Span<const unsigned int> inds, const glm::vec3 &pos, EQPhysicsFlags flag);
+	//every instance shares its model's bvh, placed through a compound shape
+	void RegisterInstances(const std::string &ident, EQEmu::Span<const EQEmu::InstancedModel> models, EQEmu::Span<const EQEmu::MeshInstance> instances, EQPhysicsFlags flag);
 	void UnregisterMesh(const std::string &ident);
+	//chunked maps give each resident chunk its own bodies so they can come and go with the chunk
+	void AttachChunk(const ZoneMap &map, size_t idx);
+	void DetachChunk(const ZoneMap &map, size_t idx);
+	//attaches every resident chunk that isn't yet and detaches every one that was unloaded
+	void SyncChunks(const ZoneMap &map);
 	void MoveMesh(const std::string &ident, const glm::vec3 &pos);
 	void Step();
 
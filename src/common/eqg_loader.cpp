@@ -13,8 +13,8 @@ EQEmu::EQGLoader::~EQGLoader() {
 bool EQEmu::EQGLoader::Load(std::string file, std::vector<std::shared_ptr<EQG::Geometry>> &models, std::vector<std::shared_ptr<Placeable>> &placeables,
 	std::vector<std::shared_ptr<EQG::Region>> &regions, std::vector<std::shared_ptr<Light>> &lights) {
 	// find zon file
-	EQEmu::PFS::Archive archive;
-	if(!archive.Open(file + ".eqg")) {
+	auto archive = EQEmu::PFS::ArchiveManager::Instance().Open(file + ".eqg");
+	if(!archive) {
 		eqLogMessage(LogTrace, "Failed to open %s.eqg as a standard eqg file because the file does not exist.", file.c_str());
 		return false;
 	}
@@ -22,7 +22,7 @@ bool EQEmu::EQGLoader::Load(std::string file, std::vector<std::shared_ptr<EQG::G
 	std::vector<char> zon;
 	bool zon_found = false;
 	std::vector<std::string> files;
-	archive.GetFilenames("zon", files);
+	archive->GetFilenames("zon", files);
 
 	if(files.size() == 0) {
 		if (GetZon(file + ".zon", zon)) {
@@ -30,12 +30,15 @@ bool EQEmu::EQGLoader::Load(std::string file, std::vector<std::shared_ptr<EQG::G
 		}
 	} else {
 		for(auto &f : files) {
-			if(archive.Get(f, zon)) {
-				if(zon[0] == 'E' && zon[1] == 'Q' && zon[2] == 'T' && zon[3] == 'Z' && zon[4] == 'P') {
-					eqLogMessage(LogWarn, "Unable to parse the zone file, is a eqgv4.");
-					return false;
-				}
+			//v4 zones are told apart by their magic, no need to inflate the whole file to see it
+			std::vector<char> magic;
+			if(EQEmu::PFS::ArchiveManager::Instance().Read(archive, f, 0, 5, magic) && magic.size() == 5 &&
+				magic[0] == 'E' && magic[1] == 'Q' && magic[2] == 'T' && magic[3] == 'Z' && magic[4] == 'P') {
+				eqLogMessage(LogWarn, "Unable to parse the zone file, is a eqgv4.");
+				return false;
+			}
 
+			if(EQEmu::PFS::ArchiveManager::Instance().Get(archive, f, zon)) {
 				zon_found = true;
 			}
 		}
@@ -83,7 +86,7 @@ bool EQEmu::EQGLoader::GetZon(std::string file, std::vector<char> &buffer) {
 	return false;
 }
 
-bool EQEmu::EQGLoader::ParseZon(EQEmu::PFS::Archive &archive, std::vector<char> &buffer, std::vector<std::shared_ptr<EQG::Geometry>> &models, std::vector<std::shared_ptr<Placeable>> &placeables,
+bool EQEmu::EQGLoader::ParseZon(std::shared_ptr<EQEmu::PFS::Archive> &archive, std::vector<char> &buffer, std::vector<std::shared_ptr<EQG::Geometry>> &models, std::vector<std::shared_ptr<Placeable>> &placeables,
 	std::vector<std::shared_ptr<EQG::Region>> &regions, std::vector<std::shared_ptr<Light>> &lights) {
 	uint32_t idx = 0;
 	SafeStructAllocParse(zon_header, header);
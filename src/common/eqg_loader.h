@@ -9,7 +9,7 @@
 #include "placeable.h"
 #include "eqg_region.h"
 #include "light.h"
-#include "pfs.h"
+#include "pfs_archive_manager.h"
 
 namespace EQEmu
 {
@@ -23,7 +23,7 @@ public:
 		std::vector<std::shared_ptr<EQG::Region>> &regions, std::vector<std::shared_ptr<Light>> &lights);
 private:
 	bool GetZon(std::string file, std::vector<char> &buffer);
-	bool ParseZon(EQEmu::PFS::Archive &archive, std::vector<char> &buffer, std::vector<std::shared_ptr<EQG::Geometry>> &models, std::vector<std::shared_ptr<Placeable>> &placeables,
+	bool ParseZon(std::shared_ptr<EQEmu::PFS::Archive> &archive, std::vector<char> &buffer, std::vector<std::shared_ptr<EQG::Geometry>> &models, std::vector<std::shared_ptr<Placeable>> &placeables,
 		std::vector<std::shared_ptr<EQG::Region>> &regions, std::vector<std::shared_ptr<Light>> &lights);
 };
 
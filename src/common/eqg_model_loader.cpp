@@ -11,10 +11,10 @@ EQEmu::EQGModelLoader::EQGModelLoader() {
 EQEmu::EQGModelLoader::~EQGModelLoader() {
 }
 
-bool EQEmu::EQGModelLoader::Load(EQEmu::PFS::Archive &archive, std::string model, std::shared_ptr<EQG::Geometry> model_out) {
+bool EQEmu::EQGModelLoader::Load(std::shared_ptr<EQEmu::PFS::Archive> &archive, std::string model, std::shared_ptr<EQG::Geometry> model_out) {
 	eqLogMessage(LogTrace, "Loading model %s.", model.c_str());
 	std::vector<char> buffer;
-	if(!archive.Get(model, buffer)) {
+	if(!EQEmu::PFS::ArchiveManager::Instance().Get(archive, model, buffer)) {
 		eqLogMessage(LogError, "Unable to load %s, file was not found.", model.c_str());
 		return false;
 	}
@@ -3,7 +3,7 @@
 
 #include <stdint.h>
 #include <memory>
-#include "pfs.h"
+#include "pfs_archive_manager.h"
 #include "eqg_geometry.h"
 
 namespace EQEmu
@@ -14,7 +14,7 @@ class EQGModelLoader
 public:
 	EQGModelLoader();
 	~EQGModelLoader();
-	bool Load(EQEmu::PFS::Archive &archive, std::string model, std::shared_ptr<EQG::Geometry> model_out);
+	bool Load(std::shared_ptr<EQEmu::PFS::Archive> &archive, std::string model, std::shared_ptr<EQG::Geometry> model_out);
 };
 
 }
@@ -15,8 +15,8 @@ EQEmu::EQG4Loader::~EQG4Loader() {
 
 bool EQEmu::EQG4Loader::Load(std::string file, std::shared_ptr<EQG::Terrain> &terrain)
 {
-	EQEmu::PFS::Archive archive;
-	if (!archive.Open(file + ".eqg")) {
+	auto archive = EQEmu::PFS::ArchiveManager::Instance().Open(file + ".eqg");
+	if (!archive) {
 		eqLogMessage(LogTrace, "Failed to open %s.eqg as an eqgv4 file because the file does not exist.", file.c_str());
 		return false;
 	}
@@ -24,7 +24,7 @@ bool EQEmu::EQG4Loader::Load(std::string file, std::shared_ptr<EQG::Terrain> &te
 	std::vector<char> zon;
 	bool zon_found = false;
 	std::vector<std::string> files;
-	archive.GetFilenames("zon", files);
+	archive->GetFilenames("zon", files);
 
 	if (files.size() == 0) {
 		if (GetZon(file + ".zon", zon)) {
@@ -33,8 +33,14 @@ bool EQEmu::EQG4Loader::Load(std::string file, std::shared_ptr<EQG::Terrain> &te
 	}
 	else {
 		for(auto &f : files) {
-			if(archive.Get(f, zon)) {
-				if(zon[0] == 'E' && zon[1] == 'Q' && zon[2] == 'T' && zon[3] == 'Z' && zon[4] == 'P') {
+			//only the v4 zon is worth inflating, check the magic first
+			std::vector<char> magic;
+			if(!EQEmu::PFS::ArchiveManager::Instance().Read(archive, f, 0, 5, magic) || magic.size() != 5) {
+				continue;
+			}
+
+			if(magic[0] == 'E' && magic[1] == 'Q' && magic[2] == 'T' && magic[3] == 'Z' && magic[4] == 'P') {
+				if(EQEmu::PFS::ArchiveManager::Instance().Get(archive, f, zon)) {
 					zon_found = true;
 					break;
 				}
@@ -112,10 +118,10 @@ float HeightWithinQuad(glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, glm::vec3 p4, f
 	return (((n.x) * (x - a.x) + (n.y) * (y - a.y)) / -n.z) + a.z;
 }
 
-bool EQEmu::EQG4Loader::ParseZoneDat(EQEmu::PFS::Archive &archive, std::shared_ptr<EQG::Terrain> &terrain) {
+bool EQEmu::EQG4Loader::ParseZoneDat(std::shared_ptr<EQEmu::PFS::Archive> &archive, std::shared_ptr<EQG::Terrain> &terrain) {
 	std::string filename = terrain->GetOpts().name + ".dat";
 	std::vector<char> buffer;
-	if(!archive.Get(filename, buffer)) {
+	if(!EQEmu::PFS::ArchiveManager::Instance().Get(archive, filename, buffer)) {
 		eqLogMessage(LogError, "Failed to open %s.", filename.c_str());
 		return false;
 	}
@@ -443,7 +449,7 @@ bool EQEmu::EQG4Loader::ParseZoneDat(EQEmu::PFS::Archive &archive, std::shared_p
 			SafeVarAllocParse(float, z_adjust);
 
 			std::vector<char> tog_buffer;
-			if(!archive.Get(tog_name + ".tog", tog_buffer))
+			if(!EQEmu::PFS::ArchiveManager::Instance().Get(archive, tog_name + ".tog", tog_buffer))
 			{
 				eqLogMessage(LogWarn, "Failed to load tog file %s.tog.", tog_name.c_str());
 				continue;
@@ -539,9 +545,9 @@ bool EQEmu::EQG4Loader::ParseZoneDat(EQEmu::PFS::Archive &archive, std::shared_p
 	return true;
 }
 
-bool EQEmu::EQG4Loader::ParseWaterDat(EQEmu::PFS::Archive &archive, std::shared_ptr<EQG::Terrain> &terrain) {
+bool EQEmu::EQG4Loader::ParseWaterDat(std::shared_ptr<EQEmu::PFS::Archive> &archive, std::shared_ptr<EQG::Terrain> &terrain) {
 	std::vector<char> wat;
-	if(!archive.Get("water.dat", wat)) {
+	if(!EQEmu::PFS::ArchiveManager::Instance().Get(archive, "water.dat", wat)) {
 		return false;
 	}
 
@@ -643,9 +649,9 @@ bool EQEmu::EQG4Loader::ParseWaterDat(EQEmu::PFS::Archive &archive, std::shared_
 	return true;
 }
 
-bool EQEmu::EQG4Loader::ParseInvwDat(EQEmu::PFS::Archive &archive, std::shared_ptr<EQG::Terrain> &terrain) {
+bool EQEmu::EQG4Loader::ParseInvwDat(std::shared_ptr<EQEmu::PFS::Archive> &archive, std::shared_ptr<EQG::Terrain> &terrain) {
 	std::vector<char> invw;
-	if (!archive.Get("invw.dat", invw)) {
+	if (!EQEmu::PFS::ArchiveManager::Instance().Get(archive, "invw.dat", invw)) {
 		return false;
 	}
 
@@ -8,7 +8,7 @@
 #include "placeable.h"
 #include "placeable_group.h"
 #include "eqg_terrain.h"
-#include "pfs.h"
+#include "pfs_archive_manager.h"
 
 namespace EQEmu
 {
@@ -20,9 +20,9 @@ public:
 	~EQG4Loader();
 	bool Load(std::string file, std::shared_ptr<EQG::Terrain> &terrain);
 private:
-	bool ParseZoneDat(EQEmu::PFS::Archive &archive, std::shared_ptr<EQG::Terrain> &terrain);
-	bool ParseWaterDat(EQEmu::PFS::Archive &archive, std::shared_ptr<EQG::Terrain> &terrain);
-	bool ParseInvwDat(EQEmu::PFS::Archive &archive, std::shared_ptr<EQG::Terrain> &terrain);
+	bool ParseZoneDat(std::shared_ptr<EQEmu::PFS::Archive> &archive, std::shared_ptr<EQG::Terrain> &terrain);
+	bool ParseWaterDat(std::shared_ptr<EQEmu::PFS::Archive> &archive, std::shared_ptr<EQG::Terrain> &terrain);
+	bool ParseInvwDat(std::shared_ptr<EQEmu::PFS::Archive> &archive, std::shared_ptr<EQG::Terrain> &terrain);
 	bool GetZon(std::string file, std::vector<char> &buffer);
 	void ParseConfigFile(std::vector<char> &buffer, std::vector<std::string> &tokens);
 	bool ParseZon(std::vector<char> &buffer, EQG::Terrain::ZoneOptions &opts);
@@ -0,0 +1,110 @@
+#include "memory_mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+EQEmu::MemoryMappedFile::MemoryMappedFile() {
+	data = nullptr;
+	size = 0;
+#ifdef _WIN32
+	file_handle = INVALID_HANDLE_VALUE;
+	map_handle = nullptr;
+#endif
+}
+
+EQEmu::MemoryMappedFile::~MemoryMappedFile() {
+	Close();
+}
+
+#ifdef _WIN32
+bool EQEmu::MemoryMappedFile::Open(const std::string &filename) {
+	Close();
+
+	file_handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER sz;
+	if (!GetFileSizeEx(file_handle, &sz) || sz.QuadPart == 0) {
+		Close();
+		return false;
+	}
+
+	map_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!map_handle) {
+		Close();
+		return false;
+	}
+
+	data = (const char*)MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		Close();
+		return false;
+	}
+
+	size = (size_t)sz.QuadPart;
+	return true;
+}
+
+void EQEmu::MemoryMappedFile::Close() {
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+
+	if (map_handle) {
+		CloseHandle(map_handle);
+	}
+
+	if (file_handle != INVALID_HANDLE_VALUE) {
+		CloseHandle(file_handle);
+	}
+
+	data = nullptr;
+	size = 0;
+	file_handle = INVALID_HANDLE_VALUE;
+	map_handle = nullptr;
+}
+#else
+bool EQEmu::MemoryMappedFile::Open(const std::string &filename) {
+	Close();
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	void *addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	//the mapping holds its own reference to the file
+	close(fd);
+
+	if (addr == MAP_FAILED) {
+		return false;
+	}
+
+	data = (const char*)addr;
+	size = (size_t)st.st_size;
+	return true;
+}
+
+void EQEmu::MemoryMappedFile::Close() {
+	if (data) {
+		munmap((void*)data, size);
+	}
+
+	data = nullptr;
+	size = 0;
+}
+#endif
@@ -0,0 +1,37 @@
+#ifndef EQEMU_COMMON_MEMORY_MAPPED_FILE_H
+#define EQEMU_COMMON_MEMORY_MAPPED_FILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace EQEmu
+{
+
+//Read only view of an entire file, backed by mmap / MapViewOfFile
+class MemoryMappedFile
+{
+public:
+	MemoryMappedFile();
+	~MemoryMappedFile();
+
+	bool Open(const std::string &filename);
+	void Close();
+
+	const char *Data() const { return data; }
+	size_t Size() const { return size; }
+private:
+	MemoryMappedFile(const MemoryMappedFile &s);
+	const MemoryMappedFile &operator=(const MemoryMappedFile &s);
+
+	const char *data;
+	size_t size;
+#ifdef _WIN32
+	void *file_handle;
+	void *map_handle;
+#endif
+};
+
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef EQEMU_COMMON_MESH_INSTANCE_H
+#define EQEMU_COMMON_MESH_INSTANCE_H
+
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace EQEmu
+{
+
+//a model's triangles stored once, in the model's own space
+struct InstancedModel
+{
+	std::vector<glm::vec3> verts;
+	std::vector<unsigned int> inds;
+};
+
+//one placement of a model, transform takes model space straight to world space
+struct MeshInstance
+{
+	uint32_t model;
+	glm::mat4x3 transform;
+};
+
+}
+
+#endif
@@ -1,16 +1,25 @@
 #include "pfs.h"
 #include "pfs_crc.h"
 #include "compression.h"
+#include "thread_pool.h"
 #include <algorithm>
 #include <cctype>
 #include <cstring>
 #include <tuple>
+#include <unordered_map>
+#include <atomic>
+#include <filesystem>
 
 #define MAX_BLOCK_SIZE 8192 // the client will crash if you make this bigger, so don't.
+#define MIN_PARALLEL_BLOCKS 32 // below ~256kb it's not worth waking the pool
+#define SAVE_WINDOW_BLOCKS 512 // blocks compressed together before being written out
 
 #define ReadFromBuffer(type, var, buffer, idx) if(idx + sizeof(type) > buffer.size()) { return false; } type var = *(type*)&buffer[idx];
 #define ReadFromBufferLength(var, len, buffer, idx) if(idx + len > buffer.size()) { return false; } memcpy(var, &buffer[idx], len);
 
+#define ReadFromRegion(type, var, data, data_len, idx) if((size_t)idx + sizeof(type) > data_len) { return false; } type var; memcpy(&var, &data[idx], sizeof(type));
+#define ReadFromRegionLength(var, len, data, data_len, idx) if((size_t)idx + len > data_len) { return false; } memcpy(var, &data[idx], len);
+
 #define WriteToBuffer(type, val, buffer, idx) if(idx + sizeof(type) > buffer.size()) { buffer.resize(idx + sizeof(type)); } *(type*)&buffer[idx] = val;  
 #define WriteToBufferLength(var, len, buffer, idx) if(idx + len > buffer.size()) { buffer.resize(idx + len); } memcpy(&buffer[idx], var, len);
 
@@ -29,44 +38,35 @@ bool EQEmu::PFS::Archive::Open(uint32_t date) {
 bool EQEmu::PFS::Archive::Open(std::string filename) {
 	Close();
 
-	std::vector<char> buffer;
-	FILE *f = fopen(filename.c_str(), "rb");
-	if (f) {
-		fseek(f, 0, SEEK_END);
-		size_t sz = ftell(f);
-		rewind(f);
-
-		buffer.resize(sz);
-		size_t res = fread(&buffer[0], 1, sz, f);
-		if (res != sz) {
-			return false;
-		}
-
-		fclose(f);
-	}
-	else {
+	std::unique_ptr<MemoryMappedFile> mapped(new MemoryMappedFile());
+	if (!mapped->Open(filename)) {
 		return false;
 	}
 
+	const char *data = mapped->Data();
+	size_t data_len = mapped->Size();
+
 	char magic[4];
-	ReadFromBuffer(uint32_t, dir_offset, buffer, 0);
-	ReadFromBufferLength(magic, 4, buffer, 4);
+	ReadFromRegion(uint32_t, dir_offset, data, data_len, 0);
+	ReadFromRegionLength(magic, 4, data, data_len, 4);
 
 	if(magic[0] != 'P' || magic[1] != 'F' || magic[2] != 'S' || magic[3] != ' ') {
 		return false;
 	}
 
-	ReadFromBuffer(uint32_t, dir_count, buffer, dir_offset);
+	ReadFromRegion(uint32_t, dir_count, data, data_len, dir_offset);
 	std::vector<std::tuple<int32_t, uint32_t, uint32_t>> directory_entries;
-	std::vector<std::tuple<int32_t, std::string>> filename_entries;
+	std::unordered_map<int32_t, std::string> filename_entries;
+	directory_entries.reserve(dir_count);
+	filename_entries.reserve(dir_count);
 	for(uint32_t i = 0; i < dir_count; ++i) {
-		ReadFromBuffer(int32_t, crc, buffer, dir_offset + 4 + (i * 12));
-		ReadFromBuffer(uint32_t, offset, buffer, dir_offset + 8 + (i * 12));
-		ReadFromBuffer(uint32_t, size, buffer, dir_offset + 12 + (i * 12));
+		ReadFromRegion(int32_t, crc, data, data_len, dir_offset + 4 + (i * 12));
+		ReadFromRegion(uint32_t, offset, data, data_len, dir_offset + 8 + (i * 12));
+		ReadFromRegion(uint32_t, size, data, data_len, dir_offset + 12 + (i * 12));
 
 		if (crc == 0x61580ac9) {
 			std::vector<char> filename_buffer;
-			if(!InflateByFileOffset(offset, size, buffer, filename_buffer)) {
+			if(!InflateByFileOffset(offset, size, data, data_len, filename_buffer)) {
 				return false;
 			}
 
@@ -84,63 +84,226 @@ bool EQEmu::PFS::Archive::Open(std::string filename) {
 
 				std::transform(filename.begin(), filename.end(), filename.begin(), ::tolower);
 				int32_t crc = EQEmu::PFS::CRC::Instance().Get(filename);
-				filename_entries.push_back(std::make_tuple(crc, filename));
+
+				//first name wins if two ever share a crc
+				filename_entries.emplace(crc, std::move(filename));
 			}
 		} else {
 			directory_entries.push_back(std::make_tuple(crc, offset, size));
 		}
 	}
-	
+
+	files_by_name.reserve(filename_entries.size());
 	auto iter = directory_entries.begin();
 	while(iter != directory_entries.end()) {
-		int32_t crc = std::get<0>((*iter));
-
-		auto f_iter = filename_entries.begin();
-		while(f_iter != filename_entries.end()) {
-			int32_t f_crc = std::get<0>((*f_iter));
-
-			if(crc == f_crc) {
-				uint32_t offset = std::get<1>((*iter));
-				uint32_t size = std::get<2>((*iter));
-				std::string filename = std::get<1>((*f_iter));
-				if (!StoreBlocksByFileOffset(offset, size, buffer, filename)) {
-					return false;
-				}
-
-				break;
-			}
-
-			++f_iter;
+		auto f_iter = filename_entries.find(std::get<0>((*iter)));
+		if(f_iter != filename_entries.end()) {
+			//entries stay compressed in the mapped archive until they're asked for
+			Entry &entry = Insert(f_iter->second)->second;
+			entry.offset = std::get<1>((*iter));
+			entry.size = std::get<2>((*iter));
+			entry.mapped = true;
 		}
 		++iter;
 	}
 
 	uint32_t footer_offset = dir_offset + 4 + (12 * dir_count);
-	if (footer_offset == buffer.size()) {
+	if (footer_offset == data_len) {
 		footer = false;
 	} else {
 		char magic[5];
-		ReadFromBufferLength(magic, 5, buffer, footer_offset);
-		ReadFromBuffer(uint32_t, date, buffer, footer_offset + 5);
+		ReadFromRegionLength(magic, 5, data, data_len, footer_offset);
+		ReadFromRegion(uint32_t, date, data, data_len, footer_offset + 5);
 		footer = true;
 		footer_date = date;
 	}
 
+	archive_file = std::move(mapped);
+	archive_path = filename;
 	return true;
 }
 
 bool EQEmu::PFS::Archive::Save(std::string filename) {
+	//written next to the target and moved over it at the end since we may be saving over the archive we have mapped
+	std::string temp_filename = filename + ".tmp";
+	FILE *f = fopen(temp_filename.c_str(), "wb");
+	if (!f) {
+		return false;
+	}
+
+	std::vector<char> header;
+	WriteToBuffer(uint32_t, 0, header, 0);
+	WriteToBuffer(uint8_t, 'P', header, 4);
+	WriteToBuffer(uint8_t, 'F', header, 5);
+	WriteToBuffer(uint8_t, 'S', header, 6);
+	WriteToBuffer(uint8_t, ' ', header, 7);
+	WriteToBuffer(uint32_t, 131072, header, 8);
+
+	std::vector<uint32_t> offsets;
+	if (fwrite(&header[0], header.size(), 1, f) != 1 || !WriteArchive(f, (uint32_t)header.size(), false, offsets)) {
+		fclose(f);
+		remove(temp_filename.c_str());
+		return false;
+	}
+
+	if (fclose(f) != 0) {
+		remove(temp_filename.c_str());
+		return false;
+	}
+
+	//windows won't let us replace a file that is still mapped
+	archive_file.reset();
+
+	std::error_code ec;
+	std::filesystem::rename(temp_filename, filename, ec);
+	if (ec) {
+		remove(temp_filename.c_str());
+		if (!archive_path.empty()) {
+			archive_file.reset(new MemoryMappedFile());
+			if (!archive_file->Open(archive_path)) {
+				Close();
+			}
+		}
+		return false;
+	}
+
+	//everything now lives in the file we just wrote, so serve entries from there
+	return Remap(filename, offsets);
+}
+
+bool EQEmu::PFS::Archive::SaveInPlace() {
+	if (!archive_file) {
+		return false;
+	}
+
+	FILE *f = fopen(archive_path.c_str(), "r+b");
+	if (!f) {
+		return false;
+	}
+
+	//new data goes after everything already in the file, the old directory stays valid until the header is patched
+	if (fseek(f, 0, SEEK_END) != 0) {
+		fclose(f);
+		return false;
+	}
+
+	long end = ftell(f);
+	if (end < 0 || (unsigned long)end > 0xFFFFFFFFUL) {
+		fclose(f);
+		return false;
+	}
+
+	std::vector<uint32_t> offsets;
+	bool res = WriteArchive(f, (uint32_t)end, true, offsets);
+	if (fclose(f) != 0) {
+		res = false;
+	}
+
+	if (!res) {
+		//a partial write only leaves junk past the end of the old archive
+		return false;
+	}
+
+	std::string filename = archive_path;
+	return Remap(filename, offsets);
+}
+
+bool EQEmu::PFS::Archive::Remap(const std::string &filename, const std::vector<uint32_t> &offsets) {
+	archive_file.reset();
+
+	std::unique_ptr<MemoryMappedFile> mapped(new MemoryMappedFile());
+	if (!mapped->Open(filename)) {
+		Close();
+		return false;
+	}
+
+	size_t i = 0;
+	auto iter = files.begin();
+	while (iter != files.end()) {
+		auto &entry = iter->second;
+		entry.offset = offsets[i++];
+		entry.mapped = true;
+		entry.blocks.reset();
+		std::vector<char>().swap(entry.data);
+		++iter;
+	}
+
+	archive_file = std::move(mapped);
+	archive_path = filename;
+	return true;
+}
+
+bool EQEmu::PFS::Archive::WriteArchive(FILE *f, uint32_t position, bool append, std::vector<uint32_t> &offsets) {
 	std::vector<char> buffer;
 
-	//Write Header
-	WriteToBuffer(uint32_t, 0, buffer, 0);
-	WriteToBuffer(uint8_t, 'P', buffer, 4);
-	WriteToBuffer(uint8_t, 'F', buffer, 5);
-	WriteToBuffer(uint8_t, 'S', buffer, 6);
-	WriteToBuffer(uint8_t, ' ', buffer, 7);
-	WriteToBuffer(uint32_t, 131072, buffer, 8);
+	struct SaveBlock
+	{
+		const char *in;
+		uint32_t in_size;
+		bool compress;
+		//index into offsets when this is the first block of an entry
+		size_t entry;
+		bool first;
+		uint32_t out_size;
+	};
+
+	//blocks are compressed a window at a time in parallel then written in order
+	std::vector<SaveBlock> window;
+	std::vector<char> window_out;
+	window.reserve(SAVE_WINDOW_BLOCKS);
+	window_out.resize(SAVE_WINDOW_BLOCKS * (MAX_BLOCK_SIZE + 128 + 8));
+
+	auto flush = [&]() -> bool {
+		std::atomic<bool> failed(false);
+		EQEmu::ThreadPool::Instance().ParallelFor(window.size(), [&](size_t i) {
+			auto &b = window[i];
+			if (!b.compress) {
+				return;
+			}
+
+			char *out = &window_out[i * (MAX_BLOCK_SIZE + 128 + 8)];
+			uint32_t deflate_size = EQEmu::DeflateData(b.in, b.in_size, out + 8, MAX_BLOCK_SIZE + 128, compression);
+			if (deflate_size == 0) {
+				failed = true;
+				return;
+			}
 
-	std::vector<std::tuple<int32_t, uint32_t, uint32_t>> dir_entries;
+			memcpy(out, &deflate_size, sizeof(uint32_t));
+			memcpy(out + 4, &b.in_size, sizeof(uint32_t));
+			b.out_size = deflate_size + 8;
+		});
+
+		if (failed) {
+			return false;
+		}
+
+		for (size_t i = 0; i < window.size(); ++i) {
+			auto &b = window[i];
+			if (b.first) {
+				offsets[b.entry] = position;
+			}
+
+			const char *out = b.compress ? &window_out[i * (MAX_BLOCK_SIZE + 128 + 8)] : b.in;
+			if (b.out_size > 0 && fwrite(out, b.out_size, 1, f) != 1) {
+				return false;
+			}
+
+			position += b.out_size;
+		}
+
+		window.clear();
+		return true;
+	};
+
+	auto add_block = [&](const SaveBlock &b) -> bool {
+		window.push_back(b);
+		if (window.size() == SAVE_WINDOW_BLOCKS) {
+			return flush();
+		}
+		return true;
+	};
+
+	std::vector<std::tuple<int32_t, uint32_t>> dir_entries;
 	std::vector<char> files_list;
 	uint32_t file_offset = 0;
 	uint32_t file_size = 0;
@@ -148,19 +311,48 @@ bool EQEmu::PFS::Archive::Save(std::string filename) {
 	uint32_t file_count = (uint32_t)files.size();
 	uint32_t file_pos = 0;
 
+	offsets.resize(files.size());
 	WriteToBuffer(uint32_t, file_count, files_list, file_pos);
 	file_pos += 4;
 
+	size_t entry_index = 0;
 	auto iter = files.begin();
 	while(iter != files.end()) {
+		auto &entry = iter->second;
 		int32_t crc = EQEmu::PFS::CRC::Instance().Get(iter->first);
-		uint32_t offset = (uint32_t)buffer.size();
-		uint32_t sz = files_uncompressed_size[iter->first];
+		dir_entries.push_back(std::make_tuple(crc, entry.size));
+
+		if (entry.mapped && append) {
+			//untouched entries stay exactly where they are
+			offsets[entry_index] = entry.offset;
+		} else if (entry.mapped) {
+			//already compressed, copied through untouched
+			uint32_t block_len = 0;
+			if (!GetBlockLength(archive_file->Data(), archive_file->Size(), entry.offset, entry.size, block_len)) {
+				return false;
+			}
+
+			SaveBlock b = { archive_file->Data() + entry.offset, block_len, false, entry_index, true, block_len };
+			if (!add_block(b)) {
+				return false;
+			}
+		} else {
+			uint32_t pos = 0;
+			uint32_t remain = entry.size;
+			bool first = true;
+			do {
+				uint32_t sz = std::min(remain, (uint32_t)MAX_BLOCK_SIZE);
+				SaveBlock b = { entry.data.data() + pos, sz, sz > 0, entry_index, first, 0 };
+				if (!add_block(b)) {
+					return false;
+				}
 
-		buffer.insert(buffer.end(), iter->second.begin(), iter->second.end());
+				pos += sz;
+				remain -= sz;
+				first = false;
+			} while (remain > 0);
+		}
 
-		dir_entries.push_back(std::make_tuple(crc, offset, sz));
-		
 		uint32_t filename_len = (uint32_t)iter->first.length() + 1;
 		WriteToBuffer(uint32_t, filename_len, files_list, file_pos);
 		file_pos += 4;
@@ -169,37 +361,38 @@ bool EQEmu::PFS::Archive::Save(std::string filename) {
 		file_pos += filename_len;
 		
 		WriteToBuffer(uint8_t, 0, files_list, file_pos - 1);
+		++entry_index;
 		++iter;
 	}
 
-	file_offset = (uint32_t)buffer.size();
+	if (!flush()) {
+		return false;
+	}
+
+	buffer.clear();
+	file_offset = position;
 	if (!WriteDeflatedFileBlock(files_list, buffer)) {
 		return false;
 	}
 
 	file_size = (uint32_t)files_list.size();
+	dir_offset = position + (uint32_t)buffer.size();
 
-	dir_offset = (uint32_t)buffer.size();
-	WriteToBuffer(uint32_t, dir_offset, buffer, 0);
-
-	uint32_t cur_dir_entry_offset = dir_offset;
+	uint32_t cur_dir_entry_offset = (uint32_t)buffer.size();
 	uint32_t dir_count = (uint32_t)dir_entries.size() + 1;
 	WriteToBuffer(uint32_t, dir_count, buffer, cur_dir_entry_offset);
 
 	cur_dir_entry_offset += 4;
-	auto dir_iter = dir_entries.begin();
-	while(dir_iter != dir_entries.end())
-	{
-		int32_t crc = std::get<0>(*dir_iter);
-		uint32_t offset = std::get<1>(*dir_iter);
-		uint32_t size = std::get<2>(*dir_iter);
+	for (size_t i = 0; i < dir_entries.size(); ++i) {
+		int32_t crc = std::get<0>(dir_entries[i]);
+		uint32_t offset = offsets[i];
+		uint32_t size = std::get<1>(dir_entries[i]);
 
 		WriteToBuffer(int32_t, crc, buffer, cur_dir_entry_offset);
 		WriteToBuffer(uint32_t, offset, buffer, cur_dir_entry_offset + 4);
 		WriteToBuffer(uint32_t, size, buffer, cur_dir_entry_offset + 8);
 
 		cur_dir_entry_offset += 12;
-		++dir_iter;
 	}
 
 	WriteToBuffer(int32_t, 0x61580AC9, buffer, cur_dir_entry_offset);
@@ -215,16 +408,13 @@ bool EQEmu::PFS::Archive::Save(std::string filename) {
 		WriteToBuffer(int8_t, 'E', buffer, cur_dir_entry_offset + 4);
 		WriteToBuffer(uint32_t, footer_date, buffer, cur_dir_entry_offset + 5);
 	}
-	
-	FILE *f = fopen(filename.c_str(), "wb");
-	if(f) {
-		size_t sz = fwrite(&buffer[0], buffer.size(), 1, f);
-		if(sz != 1) {
-			fclose(f);
-			return false;
-		}
-		fclose(f);
-	} else {
+
+	if (fwrite(&buffer[0], buffer.size(), 1, f) != 1) {
+		return false;
+	}
+
+	//the header is patched last, until then the file still describes the old directory
+	if (fflush(f) != 0 || fseek(f, 0, SEEK_SET) != 0 || fwrite(&dir_offset, sizeof(uint32_t), 1, f) != 1) {
 		return false;
 	}
 
@@ -234,152 +424,375 @@ bool EQEmu::PFS::Archive::Save(std::string filename) {
 void EQEmu::PFS::Archive::Close() {
 	footer = false;
 	footer_date = 0;
+	files_by_name.clear();
+	files_by_ext.clear();
 	files.clear();
-	files_uncompressed_size.clear();
+	archive_file.reset();
+	archive_path.clear();
 }
 
-bool EQEmu::PFS::Archive::Get(std::string filename, std::vector<char> &buf) {
-	std::transform(filename.begin(), filename.end(), filename.begin(), ::tolower);
-
-	auto iter = files.find(filename);
+bool EQEmu::PFS::Archive::Get(const std::string &filename, std::vector<char> &buf) {
+	auto iter = Find(filename);
 	if(iter != files.end()) {
 		buf.clear();
 
-		uint32_t uc_size = files_uncompressed_size[filename];
-		if(!InflateByFileOffset(0, uc_size, iter->second, buf)) {
-			return false;
+		auto &entry = iter->second;
+		if (entry.mapped) {
+			return InflateByFileOffset(entry.offset, entry.size, archive_file->Data(), archive_file->Size(), buf);
 		}
-		
+
+		buf = entry.data;
 		return true;
 	}
 
 	return false;
 }
 
-bool EQEmu::PFS::Archive::Set(std::string filename, const std::vector<char> &buf) {
-	std::transform(filename.begin(), filename.end(), filename.begin(), ::tolower);
+bool EQEmu::PFS::Archive::Read(const std::string &filename, uint32_t offset, uint32_t length, std::vector<char> &buf) {
+	auto iter = Find(filename);
+	if (iter == files.end()) {
+		return false;
+	}
 
-	std::vector<char> vec;
-	uint32_t uc_size = (uint32_t)buf.size();
-	if(!WriteDeflatedFileBlock(buf, vec)) {
+	auto &entry = iter->second;
+	if (offset > entry.size) {
 		return false;
 	}
 
-	files[filename] = vec;
-	files_uncompressed_size[filename] = uc_size;
+	uint32_t count = std::min(length, entry.size - offset);
+	if (!entry.mapped) {
+		buf.assign(entry.data.begin() + offset, entry.data.begin() + offset + count);
+		return true;
+	}
+
+	auto blocks = GetBlockIndex(entry);
+	if (!blocks) {
+		return false;
+	}
+
+	buf.resize(count);
+	if (count == 0) {
+		return true;
+	}
+
+	const char *data = archive_file->Data();
+	size_t data_len = archive_file->Size();
+	uint32_t end = offset + count;
+
+	//last block starting at or before offset
+	auto block = std::upper_bound(blocks->begin(), blocks->end(), offset,
+		[](uint32_t v, const BlockIndex &b) { return v < b.inflate_offset; });
+	if (block == blocks->begin()) {
+		return false;
+	}
+	--block;
+
+	std::vector<char> scratch;
+	for (; block != blocks->end() && block->inflate_offset < end; ++block) {
+		ReadFromRegion(uint32_t, deflate_length, data, data_len, block->position);
+		ReadFromRegion(uint32_t, inflate_length, data, data_len, block->position + 4);
+
+		uint32_t block_end = block->inflate_offset + inflate_length;
+		uint32_t from = std::max(offset, block->inflate_offset);
+		uint32_t to = std::min(end, block_end);
+		if (from >= to) {
+			continue;
+		}
+
+		//blocks wholly inside the range go straight to the output
+		if (from == block->inflate_offset && to == block_end) {
+			if (EQEmu::InflateData(data + block->position + 8, deflate_length, &buf[from - offset], inflate_length) != inflate_length) {
+				return false;
+			}
+			continue;
+		}
+
+		scratch.resize(inflate_length);
+		if (EQEmu::InflateData(data + block->position + 8, deflate_length, &scratch[0], inflate_length) != inflate_length) {
+			return false;
+		}
+
+		memcpy(&buf[from - offset], &scratch[from - block->inflate_offset], to - from);
+	}
 
 	return true;
 }
 
-bool EQEmu::PFS::Archive::Delete(std::string filename) {
-	std::transform(filename.begin(), filename.end(), filename.begin(), ::tolower);
-
-	files.erase(filename);
-	files_uncompressed_size.erase(filename);
+bool EQEmu::PFS::Archive::Set(const std::string &filename, const std::vector<char> &buf) {
+	//compressed when the archive is saved, where blocks from every file can be deflated together
+	Entry &entry = Insert(filename)->second;
+	entry.offset = 0;
+	entry.size = (uint32_t)buf.size();
+	entry.mapped = false;
+	entry.data = buf;
+	entry.blocks.reset();
 
 	return true;
 }
 
-bool EQEmu::PFS::Archive::Rename(std::string filename, std::string filename_new) {
-	std::transform(filename.begin(), filename.end(), filename.begin(), ::tolower);
-	std::transform(filename_new.begin(), filename_new.end(), filename_new.begin(), ::tolower);
+bool EQEmu::PFS::Archive::Delete(const std::string &filename) {
+	auto iter = Find(filename);
+	if (iter != files.end()) {
+		Erase(iter);
+	}
 
-	if (files.count(filename_new) != 0) {
+	return true;
+}
+
+bool EQEmu::PFS::Archive::Rename(const std::string &filename, const std::string &filename_new) {
+	if (Find(filename_new) != files.end()) {
 		return false;
 	}
 
-	auto iter = files.find(filename);
+	auto iter = Find(filename);
 	if (iter != files.end()) {
-		files[filename_new] = iter->second;
-		files.erase(iter);
-
-		auto iter_s = files_uncompressed_size.find(filename);
-		files_uncompressed_size[filename_new] = iter_s->second;
-		files_uncompressed_size.erase(iter_s);
+		Entry entry = std::move(iter->second);
+		Erase(iter);
+		Insert(filename_new)->second = std::move(entry);
 		return true;
 	}
 
 	return false;
 }
 
-bool EQEmu::PFS::Archive::Exists(std::string filename) {
-	std::transform(filename.begin(), filename.end(), filename.begin(), ::tolower);
-
-	return files.count(filename) != 0;
+bool EQEmu::PFS::Archive::Exists(const std::string &filename) {
+	return Find(filename) != files.end();
 }
 
 bool EQEmu::PFS::Archive::GetFilenames(std::string ext, std::vector<std::string> &out_files) {
 	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
 	out_files.clear();
 
-	size_t elen = ext.length();
-	bool all_files = !ext.compare("*");
-
-	auto iter = files.begin();
-	while (iter != files.end()) {
-		if (all_files) {
+	if (!ext.compare("*")) {
+		auto iter = files.begin();
+		while (iter != files.end()) {
 			out_files.push_back(iter->first);
 			++iter;
-			continue;
 		}
+		return out_files.size() > 0;
+	}
 
-		size_t flen = iter->first.length();
-		if (flen <= elen) {
-			++iter;
-			continue;
+	//only the extension groups that could possibly end in ext get looked at
+	size_t elen = ext.length();
+	size_t groups = 0;
+	auto ext_iter = files_by_ext.begin();
+	while (ext_iter != files_by_ext.end()) {
+		auto &group_ext = ext_iter->first;
+		size_t glen = group_ext.length();
+		auto &names = ext_iter->second;
+		size_t out_sz = out_files.size();
+
+		if (glen >= elen && !group_ext.compare(glen - elen, elen, ext)) {
+			for (auto name : names) {
+				if (name->length() > elen) {
+					out_files.push_back(*name);
+				}
+			}
+		} else if (glen == 0 || (glen < elen && !ext.compare(elen - glen, glen, group_ext))) {
+			for (auto name : names) {
+				size_t flen = name->length();
+				if (flen > elen && !name->compare(flen - elen, elen, ext)) {
+					out_files.push_back(*name);
+				}
+			}
 		}
 
-		if (!strcmp(iter->first.c_str() + (flen - elen), ext.c_str())) {
-			out_files.push_back(iter->first);
+		if (out_files.size() != out_sz) {
+			++groups;
 		}
-		++iter;
+		++ext_iter;
+	}
+
+	if (groups > 1) {
+		std::sort(out_files.begin(), out_files.end());
 	}
+
 	return out_files.size() > 0;
 }
 
-bool EQEmu::PFS::Archive::StoreBlocksByFileOffset(uint32_t offset, uint32_t size, const std::vector<char> &in_buffer, std::string filename) {
+size_t EQEmu::PFS::Archive::NameHash::operator()(std::string_view name) const {
+	//fnv-1a
+	size_t hash = (size_t)14695981039346656037ULL;
+	for (auto c : name) {
+		hash ^= (size_t)::tolower((unsigned char)c);
+		hash *= (size_t)1099511628211ULL;
+	}
+
+	return hash;
+}
+
+bool EQEmu::PFS::Archive::NameEqual::operator()(std::string_view a, std::string_view b) const {
+	if (a.length() != b.length()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < a.length(); ++i) {
+		if (::tolower((unsigned char)a[i]) != ::tolower((unsigned char)b[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+EQEmu::PFS::Archive::EntryIterator EQEmu::PFS::Archive::Find(std::string_view filename) {
+	auto iter = files_by_name.find(filename);
+	if (iter != files_by_name.end()) {
+		return iter->second;
+	}
+
+	return files.end();
+}
+
+EQEmu::PFS::Archive::EntryIterator EQEmu::PFS::Archive::Insert(const std::string &filename) {
+	auto existing = Find(filename);
+	if (existing != files.end()) {
+		return existing;
+	}
+
+	std::string name = filename;
+	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+	auto iter = files.emplace(std::move(name), Entry()).first;
+	const std::string &key = iter->first;
+	files_by_name.emplace(std::string_view(key), iter);
+
+	size_t dot = key.find_last_of('.');
+	auto &names = files_by_ext[dot == std::string::npos ? std::string() : key.substr(dot + 1)];
+	auto pos = std::lower_bound(names.begin(), names.end(), &key, [](const std::string *a, const std::string *b) { return *a < *b; });
+	names.insert(pos, &key);
+
+	return iter;
+}
+
+void EQEmu::PFS::Archive::Erase(EntryIterator iter) {
+	const std::string &key = iter->first;
+	files_by_name.erase(std::string_view(key));
+
+	size_t dot = key.find_last_of('.');
+	auto ext_iter = files_by_ext.find(dot == std::string::npos ? std::string() : key.substr(dot + 1));
+	if (ext_iter != files_by_ext.end()) {
+		auto &names = ext_iter->second;
+		auto pos = std::lower_bound(names.begin(), names.end(), &key, [](const std::string *a, const std::string *b) { return *a < *b; });
+		if (pos != names.end() && *pos == &key) {
+			names.erase(pos);
+		}
+
+		if (names.empty()) {
+			files_by_ext.erase(ext_iter);
+		}
+	}
+
+	files.erase(iter);
+}
 
+bool EQEmu::PFS::Archive::GetBlockLength(const char *data, size_t data_len, uint32_t offset, uint32_t size, uint32_t &block_len) {
 	uint32_t position = offset;
-	uint32_t block_size = 0;
 	uint32_t inflate = 0;
 	while (inflate < size) {
-		ReadFromBuffer(uint32_t, deflate_length, in_buffer, position);
-		ReadFromBuffer(uint32_t, inflate_length, in_buffer, position + 4);
+		ReadFromRegion(uint32_t, deflate_length, data, data_len, position);
+		ReadFromRegion(uint32_t, inflate_length, data, data_len, position + 4);
 		inflate += inflate_length;
 		position += deflate_length + 8;
 	}
 
-	block_size = position - offset;
+	if (position > data_len) {
+		return false;
+	}
 
-	std::vector<char> tbuffer;
-	tbuffer.resize(block_size);
+	block_len = position - offset;
+	return true;
+}
 
-	memcpy(&tbuffer[0], &in_buffer[offset], block_size);
+std::shared_ptr<const std::vector<EQEmu::PFS::Archive::BlockIndex>> EQEmu::PFS::Archive::GetBlockIndex(Entry &entry) {
+	std::lock_guard<std::mutex> guard(index_lock);
+	if (entry.blocks) {
+		return entry.blocks;
+	}
 
-	files[filename] = tbuffer;
-	files_uncompressed_size[filename] = size;
-	return true;
+	const char *data = archive_file->Data();
+	size_t data_len = archive_file->Size();
+	std::shared_ptr<std::vector<BlockIndex>> blocks(new std::vector<BlockIndex>());
+	blocks->reserve(entry.size / MAX_BLOCK_SIZE + 1);
+
+	uint32_t position = entry.offset;
+	uint32_t inflate = 0;
+	while (inflate < entry.size) {
+		if ((size_t)position + 8 > data_len) {
+			return nullptr;
+		}
+
+		uint32_t deflate_length;
+		uint32_t inflate_length;
+		memcpy(&deflate_length, data + position, sizeof(uint32_t));
+		memcpy(&inflate_length, data + position + 4, sizeof(uint32_t));
+		if ((size_t)position + 8 + deflate_length > data_len || inflate + inflate_length > entry.size) {
+			return nullptr;
+		}
+
+		BlockIndex b;
+		b.position = position;
+		b.inflate_offset = inflate;
+		blocks->push_back(b);
+
+		inflate += inflate_length;
+		position += deflate_length + 8;
+	}
+
+	entry.blocks = blocks;
+	return entry.blocks;
 }
 
-bool EQEmu::PFS::Archive::InflateByFileOffset(uint32_t offset, uint32_t size, const std::vector<char> &in_buffer, std::vector<char> &out_buffer) {
-	out_buffer.resize(size);
-	memset(&out_buffer[0], 0, size);
+bool EQEmu::PFS::Archive::InflateByFileOffset(uint32_t offset, uint32_t size, const char *data, size_t data_len, std::vector<char> &out_buffer) {
+	out_buffer.assign(size, 0);
+
+	struct Block
+	{
+		uint32_t in_offset;
+		uint32_t in_size;
+		uint32_t out_offset;
+		uint32_t out_size;
+	};
+
+	//every block header tells us where it lands in the output so they can be inflated independently
+	std::vector<Block> blocks;
+	blocks.reserve(size / MAX_BLOCK_SIZE + 1);
 
 	uint32_t position = offset;
 	uint32_t inflate = 0;
 
 	while (inflate < size) {
-		std::vector<char> temp_buffer;
-		ReadFromBuffer(uint32_t, deflate_length, in_buffer, position);
-		ReadFromBuffer(uint32_t, inflate_length, in_buffer, position + 4);
-		temp_buffer.resize(deflate_length + 1);
-		ReadFromBufferLength(&temp_buffer[0], deflate_length, in_buffer, position + 8);
+		ReadFromRegion(uint32_t, deflate_length, data, data_len, position);
+		ReadFromRegion(uint32_t, inflate_length, data, data_len, position + 4);
+		if ((size_t)position + 8 + deflate_length > data_len || inflate + inflate_length > size) {
+			return false;
+		}
+
+		Block b;
+		b.in_offset = position + 8;
+		b.in_size = deflate_length;
+		b.out_offset = inflate;
+		b.out_size = inflate_length;
+		blocks.push_back(b);
 
-		EQEmu::InflateData(&temp_buffer[0], deflate_length, &out_buffer[inflate], inflate_length);
 		inflate += inflate_length;
 		position += deflate_length + 8;
 	}
 
+	char *out = out_buffer.data();
+	auto inflate_block = [&blocks, data, out](size_t i) {
+		auto &b = blocks[i];
+		EQEmu::InflateData(data + b.in_offset, b.in_size, out + b.out_offset, b.out_size);
+	};
+
+	if (blocks.size() < MIN_PARALLEL_BLOCKS) {
+		for (size_t i = 0; i < blocks.size(); ++i) {
+			inflate_block(i);
+		}
+	} else {
+		EQEmu::ThreadPool::Instance().ParallelFor(blocks.size(), inflate_block);
+	}
+
 	return true;
 }
 
@@ -398,7 +811,7 @@ bool EQEmu::PFS::Archive::WriteDeflatedFileBlock(const std::vector<char> &file,
 		}
 
 		uint32_t block_len = sz + 128;
-		uint32_t deflate_size = (uint32_t)EQEmu::DeflateData(&file[pos], sz, (char*)&block[0], block_len);
+		uint32_t deflate_size = (uint32_t)EQEmu::DeflateData(&file[pos], sz, (char*)&block[0], block_len, compression);
 		if(deflate_size == 0)
 			return false;
 
@@ -2,9 +2,16 @@
 #define EQEMU_COMMON_PFS_ARCHIVE_H
 
 #include <stdint.h>
+#include <stdio.h>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include "memory_mapped_file.h"
+#include "compression.h"
 
 namespace EQEmu
 {
@@ -22,21 +29,70 @@ public:
 	bool Open(uint32_t date);
 	bool Open(std::string filename);
 	bool Save(std::string filename);
+	bool SaveInPlace();
 	void Close();
-	bool Get(std::string filename, std::vector<char> &buf);
-	bool Set(std::string filename, const std::vector<char> &buf);
-	bool Delete(std::string filename);
-	bool Rename(std::string filename, std::string filename_new);
-	bool Exists(std::string filename);
+	bool Get(const std::string &filename, std::vector<char> &buf);
+	//reads up to length bytes starting at offset, only the blocks that overlap the range are inflated
+	bool Read(const std::string &filename, uint32_t offset, uint32_t length, std::vector<char> &buf);
+	bool Set(const std::string &filename, const std::vector<char> &buf);
+	bool Delete(const std::string &filename);
+	bool Rename(const std::string &filename, const std::string &filename_new);
+	bool Exists(const std::string &filename);
 	bool GetFilenames(std::string ext, std::vector<std::string> &out_files);
+	void SetCompressionOptions(const CompressionOptions &opts) { compression = opts; }
+	const CompressionOptions &GetCompressionOptions() const { return compression; }
 private:
-	bool StoreBlocksByFileOffset(uint32_t offset, uint32_t size, const std::vector<char> &in_buffer, std::string filename);
-	bool InflateByFileOffset(uint32_t offset, uint32_t size, const std::vector<char> &in_buffer, std::vector<char> &out_buffer);
+	struct BlockIndex
+	{
+		//position of the block header in the mapped archive
+		uint32_t position;
+		//where the block's contents start in the inflated entry
+		uint32_t inflate_offset;
+	};
+
+	struct Entry
+	{
+		//offset of the first block in the mapped archive
+		uint32_t offset;
+		uint32_t size;
+		bool mapped;
+		//contents of entries that were Set but not yet saved
+		std::vector<char> data;
+		//built on the first partial read of a mapped entry
+		std::shared_ptr<const std::vector<BlockIndex>> blocks;
+	};
+
+	//names are stored lower case but looked up without folding a copy of the caller's string
+	struct NameHash
+	{
+		size_t operator()(std::string_view name) const;
+	};
+
+	struct NameEqual
+	{
+		bool operator()(std::string_view a, std::string_view b) const;
+	};
+
+	typedef std::map<std::string, Entry>::iterator EntryIterator;
+
+	EntryIterator Find(std::string_view filename);
+	EntryIterator Insert(const std::string &filename);
+	void Erase(EntryIterator iter);
+	bool GetBlockLength(const char *data, size_t data_len, uint32_t offset, uint32_t size, uint32_t &block_len);
+	std::shared_ptr<const std::vector<BlockIndex>> GetBlockIndex(Entry &entry);
+	bool InflateByFileOffset(uint32_t offset, uint32_t size, const char *data, size_t data_len, std::vector<char> &out_buffer);
 	bool WriteDeflatedFileBlock(const std::vector<char> &file, std::vector<char> &out_buffer);
-	std::map<std::string, std::vector<char>> files;
-	std::map<std::string, uint32_t> files_uncompressed_size;
+	bool WriteArchive(FILE *f, uint32_t position, bool append, std::vector<uint32_t> &offsets);
+	bool Remap(const std::string &filename, const std::vector<uint32_t> &offsets);
+	std::map<std::string, Entry> files;
+	std::unordered_map<std::string_view, EntryIterator, NameHash, NameEqual> files_by_name;
+	std::unordered_map<std::string, std::vector<const std::string*>> files_by_ext;
+	std::unique_ptr<MemoryMappedFile> archive_file;
+	std::string archive_path;
 	bool footer;
 	uint32_t footer_date;
+	CompressionOptions compression;
+	std::mutex index_lock;
 };
 
 }
@@ -0,0 +1,197 @@
+#include "pfs_archive_manager.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#define DEFAULT_CACHE_BUDGET (256 * 1024 * 1024)
+#define DEFAULT_MAX_ARCHIVES 64
+
+EQEmu::PFS::ArchiveManager::ArchiveManager() {
+	cache_size = 0;
+	cache_budget = DEFAULT_CACHE_BUDGET;
+	max_archives = DEFAULT_MAX_ARCHIVES;
+}
+
+EQEmu::PFS::ArchiveManager &EQEmu::PFS::ArchiveManager::Instance() {
+	static ArchiveManager inst;
+	return inst;
+}
+
+std::shared_ptr<EQEmu::PFS::Archive> EQEmu::PFS::ArchiveManager::Open(const std::string &filename) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto iter = archives_by_path.find(filename);
+		if (iter != archives_by_path.end()) {
+			archives.splice(archives.begin(), archives, iter->second);
+			return iter->second->archive;
+		}
+	}
+
+	//opening only parses the directory but there's no reason to hold everyone else up for it
+	std::shared_ptr<Archive> archive(new Archive());
+	if (!archive->Open(filename)) {
+		return std::shared_ptr<Archive>();
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+	auto iter = archives_by_path.find(filename);
+	if (iter != archives_by_path.end()) {
+		archives.splice(archives.begin(), archives, iter->second);
+		return iter->second->archive;
+	}
+
+	CachedArchive ca;
+	ca.path = filename;
+	ca.archive = archive;
+	archives.push_front(ca);
+	archives_by_path[filename] = archives.begin();
+
+	while (archives.size() > max_archives) {
+		auto &oldest = archives.back();
+		EvictEntries(oldest.archive.get());
+		archives_by_path.erase(oldest.path);
+		archives.pop_back();
+	}
+
+	return archive;
+}
+
+bool EQEmu::PFS::ArchiveManager::Get(const std::shared_ptr<Archive> &archive, const std::string &filename, std::vector<char> &buf) {
+	if (!archive) {
+		return false;
+	}
+
+	std::string key = EntryKey(archive.get(), filename);
+	std::shared_ptr<const std::vector<char>> cached;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto iter = entries_by_key.find(key);
+		if (iter != entries_by_key.end()) {
+			entries.splice(entries.begin(), entries, iter->second);
+			cached = iter->second->data;
+		}
+	}
+
+	if (cached) {
+		buf.assign(cached->begin(), cached->end());
+		return true;
+	}
+
+	if (!archive->Get(filename, buf)) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+	if (buf.size() > cache_budget || entries_by_key.count(key) != 0) {
+		return true;
+	}
+
+	//entries are only cached for archives we own, anything else could be freed and its address reused
+	bool managed = false;
+	for (auto &ca : archives) {
+		if (ca.archive == archive) {
+			managed = true;
+			break;
+		}
+	}
+
+	if (!managed) {
+		return true;
+	}
+
+	CachedEntry ce;
+	ce.key = key;
+	ce.archive = archive.get();
+	ce.data.reset(new std::vector<char>(buf));
+	entries.push_front(ce);
+	entries_by_key[key] = entries.begin();
+	cache_size += buf.size();
+
+	TrimEntries();
+	return true;
+}
+
+bool EQEmu::PFS::ArchiveManager::Read(const std::shared_ptr<Archive> &archive, const std::string &filename, uint32_t offset, uint32_t length, std::vector<char> &buf) {
+	if (!archive) {
+		return false;
+	}
+
+	std::shared_ptr<const std::vector<char>> cached;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto iter = entries_by_key.find(EntryKey(archive.get(), filename));
+		if (iter != entries_by_key.end()) {
+			cached = iter->second->data;
+		}
+	}
+
+	if (cached) {
+		if (offset > cached->size()) {
+			return false;
+		}
+
+		size_t count = std::min((size_t)length, cached->size() - offset);
+		buf.assign(cached->begin() + offset, cached->begin() + offset + count);
+		return true;
+	}
+
+	return archive->Read(filename, offset, length, buf);
+}
+
+void EQEmu::PFS::ArchiveManager::SetCacheBudget(size_t bytes) {
+	std::lock_guard<std::mutex> guard(lock);
+	cache_budget = bytes;
+	TrimEntries();
+}
+
+void EQEmu::PFS::ArchiveManager::SetMaxArchives(size_t count) {
+	std::lock_guard<std::mutex> guard(lock);
+	max_archives = std::max(count, (size_t)1);
+
+	while (archives.size() > max_archives) {
+		auto &oldest = archives.back();
+		EvictEntries(oldest.archive.get());
+		archives_by_path.erase(oldest.path);
+		archives.pop_back();
+	}
+}
+
+void EQEmu::PFS::ArchiveManager::Clear() {
+	std::lock_guard<std::mutex> guard(lock);
+	entries_by_key.clear();
+	entries.clear();
+	cache_size = 0;
+	archives_by_path.clear();
+	archives.clear();
+}
+
+std::string EQEmu::PFS::ArchiveManager::EntryKey(const Archive *archive, const std::string &filename) {
+	std::string key;
+	key.resize(sizeof(archive));
+	memcpy(&key[0], &archive, sizeof(archive));
+	key += filename;
+	std::transform(key.begin() + sizeof(archive), key.end(), key.begin() + sizeof(archive), ::tolower);
+	return key;
+}
+
+void EQEmu::PFS::ArchiveManager::EvictEntries(const Archive *archive) {
+	auto iter = entries.begin();
+	while (iter != entries.end()) {
+		if (iter->archive == archive) {
+			cache_size -= iter->data->size();
+			entries_by_key.erase(iter->key);
+			iter = entries.erase(iter);
+		} else {
+			++iter;
+		}
+	}
+}
+
+void EQEmu::PFS::ArchiveManager::TrimEntries() {
+	while (cache_size > cache_budget && !entries.empty()) {
+		auto &oldest = entries.back();
+		cache_size -= oldest.data->size();
+		entries_by_key.erase(oldest.key);
+		entries.pop_back();
+	}
+}
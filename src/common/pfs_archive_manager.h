@@ -0,0 +1,71 @@
+#ifndef EQEMU_COMMON_PFS_ARCHIVE_MANAGER_H
+#define EQEMU_COMMON_PFS_ARCHIVE_MANAGER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include "pfs.h"
+
+namespace EQEmu
+{
+
+namespace PFS
+{
+
+//Keeps archives open by path and caches their decompressed entries so every loader shares them
+class ArchiveManager
+{
+public:
+	~ArchiveManager() { }
+	static ArchiveManager &Instance();
+
+	std::shared_ptr<Archive> Open(const std::string &filename);
+	bool Get(const std::shared_ptr<Archive> &archive, const std::string &filename, std::vector<char> &buf);
+	//partial reads are served from the cache when the entry is already there but never populate it
+	bool Read(const std::shared_ptr<Archive> &archive, const std::string &filename, uint32_t offset, uint32_t length, std::vector<char> &buf);
+
+	void SetCacheBudget(size_t bytes);
+	void SetMaxArchives(size_t count);
+	void Clear();
+private:
+	ArchiveManager();
+	ArchiveManager(const ArchiveManager &s);
+	const ArchiveManager &operator=(const ArchiveManager &s);
+
+	struct CachedArchive
+	{
+		std::string path;
+		std::shared_ptr<Archive> archive;
+	};
+
+	struct CachedEntry
+	{
+		std::string key;
+		const Archive *archive;
+		std::shared_ptr<const std::vector<char>> data;
+	};
+
+	std::string EntryKey(const Archive *archive, const std::string &filename);
+	void EvictEntries(const Archive *archive);
+	void TrimEntries();
+
+	//most recently used at the front of both lists
+	std::list<CachedArchive> archives;
+	std::unordered_map<std::string, std::list<CachedArchive>::iterator> archives_by_path;
+	std::list<CachedEntry> entries;
+	std::unordered_map<std::string, std::list<CachedEntry>::iterator> entries_by_key;
+	size_t cache_size;
+	size_t cache_budget;
+	size_t max_archives;
+	std::mutex lock;
+};
+
+}
+
+}
+
+#endif
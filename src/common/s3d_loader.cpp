@@ -1,5 +1,5 @@
 #include "s3d_loader.h"
-#include "pfs.h"
+#include "pfs_archive_manager.h"
 #include "wld_structs.h"
 #include "safe_alloc.h"
 #include "log_macros.h"
@@ -23,13 +23,13 @@ bool EQEmu::S3DLoader::ParseWLDFile(std::string file_name, std::string wld_name,
 	char *current_hash;
 	bool old = false;
 
-	EQEmu::PFS::Archive archive;
-	if (!archive.Open(file_name)) {
+	auto archive = EQEmu::PFS::ArchiveManager::Instance().Open(file_name);
+	if (!archive) {
 		eqLogMessage(LogDebug, "Unable to open file %s.", file_name.c_str());
 		return false;
 	}
 
-	if (!archive.Get(wld_name, buffer)) {
+	if (!EQEmu::PFS::ArchiveManager::Instance().Get(archive, wld_name, buffer)) {
 		eqLogMessage(LogDebug, "Unable to open wld file %s.", wld_name.c_str());
 		return false;
 	}
@@ -0,0 +1,34 @@
+#ifndef EQEMU_COMMON_SPAN_H
+#define EQEMU_COMMON_SPAN_H
+
+#include <stddef.h>
+
+namespace EQEmu
+{
+
+//Non owning view over a contiguous array, whoever hands one out keeps the memory alive
+template<typename T>
+class Span
+{
+public:
+	Span() : ptr(nullptr), len(0) { }
+	Span(T *p, size_t n) : ptr(p), len(n) { }
+
+	//anything with data() and size(), mostly std::vector
+	template<typename Container>
+	Span(Container &c) : ptr(c.data()), len(c.size()) { }
+
+	T *data() const { return ptr; }
+	size_t size() const { return len; }
+	bool empty() const { return len == 0; }
+	T &operator[](size_t i) const { return ptr[i]; }
+	T *begin() const { return ptr; }
+	T *end() const { return ptr + len; }
+private:
+	T *ptr;
+	size_t len;
+};
+
+}
+
+#endif
@@ -102,3 +102,37 @@ bool EQEmu::StringsEqual(const std::string& a, const std::string& b)
 	return true;
 }
 
+bool EQEmu::WildcardMatch(const std::string &pattern, const std::string &str)
+{
+	size_t p = 0;
+	size_t s = 0;
+	size_t star = std::string::npos;
+	size_t star_s = 0;
+
+	while (s < str.size()) {
+		if (p < pattern.size() && (pattern[p] == '?' || tolower(pattern[p]) == tolower(str[s]))) {
+			++p;
+			++s;
+		} else if (p < pattern.size() && pattern[p] == '*') {
+			star = p++;
+			star_s = s;
+		} else if (star != std::string::npos) {
+			//let the last star swallow one more character and try again
+			p = star + 1;
+			s = ++star_s;
+		} else {
+			return false;
+		}
+	}
+
+	while (p < pattern.size() && pattern[p] == '*') {
+		++p;
+	}
+
+	return p == pattern.size();
+}
+
+bool EQEmu::HasWildcard(const std::string &str)
+{
+	return str.find_first_of("*?") != std::string::npos;
+}
@@ -11,6 +11,9 @@ namespace EQEmu
 
 	std::vector<std::string> SplitString(const std::string &str, char delim);
 	bool StringsEqual(const std::string& a, const std::string& b);
+	//case insensitive match where * matches any run of characters and ? matches exactly one
+	bool WildcardMatch(const std::string &pattern, const std::string &str);
+	bool HasWildcard(const std::string &str);
 	
 }
 
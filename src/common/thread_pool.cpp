@@ -0,0 +1,115 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+EQEmu::ThreadPool::ThreadPool(size_t threads) {
+	running = true;
+
+	if (threads == 0) {
+		threads = 1;
+	}
+
+	for (size_t i = 0; i < threads; ++i) {
+		workers.push_back(std::thread([this]() { Worker(); }));
+	}
+}
+
+EQEmu::ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		running = false;
+	}
+
+	cv.notify_all();
+	for (auto &t : workers) {
+		t.join();
+	}
+}
+
+EQEmu::ThreadPool &EQEmu::ThreadPool::Instance() {
+	static ThreadPool inst(std::thread::hardware_concurrency());
+	return inst;
+}
+
+void EQEmu::ThreadPool::Submit(Task task) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		tasks.push_back(std::move(task));
+	}
+
+	cv.notify_one();
+}
+
+void EQEmu::ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)> &fn) {
+	if (count == 0) {
+		return;
+	}
+
+	if (count == 1 || workers.size() < 2) {
+		for (size_t i = 0; i < count; ++i) {
+			fn(i);
+		}
+		return;
+	}
+
+	struct Batch
+	{
+		std::atomic<size_t> next;
+		std::atomic<size_t> done;
+		std::mutex lock;
+		std::condition_variable cv;
+		const std::function<void(size_t)> *fn;
+	};
+
+	//helpers can still be sitting in the queue after we return, so the batch is shared with them
+	auto batch = std::make_shared<Batch>();
+	batch->next = 0;
+	batch->done = 0;
+	batch->fn = &fn;
+
+	auto run = [batch, count]() {
+		for (;;) {
+			size_t i = batch->next.fetch_add(1);
+			if (i >= count) {
+				return;
+			}
+
+			(*batch->fn)(i);
+
+			if (batch->done.fetch_add(1) + 1 == count) {
+				std::lock_guard<std::mutex> guard(batch->lock);
+				batch->cv.notify_all();
+			}
+		}
+	};
+
+	size_t helpers = std::min(workers.size(), count) - 1;
+	for (size_t i = 0; i < helpers; ++i) {
+		Submit(run);
+	}
+
+	run();
+
+	std::unique_lock<std::mutex> guard(batch->lock);
+	batch->cv.wait(guard, [&batch, count]() { return batch->done.load() == count; });
+}
+
+void EQEmu::ThreadPool::Worker() {
+	for (;;) {
+		Task task;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			cv.wait(guard, [this]() { return !running || !tasks.empty(); });
+
+			if (!running && tasks.empty()) {
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
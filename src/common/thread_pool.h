@@ -0,0 +1,47 @@
+#ifndef EQEMU_COMMON_THREAD_POOL_H
+#define EQEMU_COMMON_THREAD_POOL_H
+
+#include <stddef.h>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+namespace EQEmu
+{
+
+class ThreadPool
+{
+public:
+	typedef std::function<void(void)> Task;
+
+	ThreadPool(size_t threads);
+	~ThreadPool();
+
+	static ThreadPool &Instance();
+
+	void Submit(Task task);
+
+	//Runs fn(i) for i in [0, count) and returns once every index is done.
+	//The calling thread takes work too, so this is safe to call from inside a pool task.
+	void ParallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+	size_t Size() const { return workers.size(); }
+private:
+	ThreadPool(const ThreadPool &s);
+	const ThreadPool &operator=(const ThreadPool &s);
+
+	void Worker();
+
+	std::vector<std::thread> workers;
+	std::deque<Task> tasks;
+	std::mutex lock;
+	std::condition_variable cv;
+	bool running;
+};
+
+}
+
+#endif
@@ -0,0 +1,34 @@
+#include "wld_fragment_index.h"
+
+EQEmu::S3D::WLDFragmentIndex::WLDFragmentIndex(std::vector<WLDFragment> &frags) {
+	for (uint32_t i = 0; i < frags.size(); ++i) {
+		by_type[frags[i].type].push_back(i);
+
+		if (frags[i].type == 0x14) {
+			WLDFragment14 &frag = reinterpret_cast<WLDFragment14&>(frags[i]);
+			auto ref = frag.GetData();
+			if (ref) {
+				//emplace keeps the first actor with a name, same as a front to back scan finds
+				actors.emplace(ref->GetName(), i);
+			}
+		}
+	}
+}
+
+const std::vector<uint32_t> &EQEmu::S3D::WLDFragmentIndex::GetByType(int type) const {
+	auto iter = by_type.find(type);
+	if (iter == by_type.end()) {
+		return empty;
+	}
+
+	return iter->second;
+}
+
+int64_t EQEmu::S3D::WLDFragmentIndex::FindActor(const std::string &name) const {
+	auto iter = actors.find(name);
+	if (iter == actors.end()) {
+		return -1;
+	}
+
+	return iter->second;
+}
@@ -0,0 +1,38 @@
+#ifndef EQEMU_COMMON_WLD_FRAGMENT_INDEX_H
+#define EQEMU_COMMON_WLD_FRAGMENT_INDEX_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "wld_fragment.h"
+
+namespace EQEmu
+{
+
+namespace S3D
+{
+
+//Built once over a parsed fragment list so lookups don't have to scan it. Only holds positions,
+//the list has to stay around and unchanged for as long as the index is used
+class WLDFragmentIndex
+{
+public:
+	WLDFragmentIndex(std::vector<WLDFragment> &frags);
+	~WLDFragmentIndex() { }
+
+	//positions of every fragment of this type in file order
+	const std::vector<uint32_t> &GetByType(int type) const;
+	//position of the first 0x14 actor with this name, -1 if there isn't one
+	int64_t FindActor(const std::string &name) const;
+private:
+	std::unordered_map<int, std::vector<uint32_t>> by_type;
+	std::unordered_map<std::string, uint32_t> actors;
+	std::vector<uint32_t> empty;
+};
+
+}
+
+}
+
+#endif
@@ -3,45 +3,111 @@
 #include <map>
 #include <locale>
 #include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <cmath>
+#include <cfloat>
+#include <string.h>
 
 #include <zlib.h>
 
 #include "zone_map.h"
 #include "config.h"
+#include "memory_mapped_file.h"
+#include "affine_transform.h"
+#include "thread_pool.h"
+#include "compression.h"
+
+#define MAP_V3_VERSION 0x03000000
+#define MAP_V3_ALIGNMENT 16
+#define MAP_V3_MAX_SECTIONS 64
+#define MAP_V4_VERSION 0x04000000
+#define MAP_V2_STREAM_WINDOW 65536
+#define MAP_V2_TERRAIN_BATCH_BYTES (4 * 1024 * 1024)
+#define MAP_V2_BOUNDS_CHUNK 65536
+#define MAP_V2_CHUNKED_VERSION 0x02010000
+#define MAP_V2_CHUNK_BATCH_BYTES (8 * 1024 * 1024)
+
+//v3 is the fully expanded geometry laid out so it can be used straight from a mapping:
+//header, section table, then every section starting on a 16 byte boundary
+enum MapV3SectionType
+{
+	MapV3CollideVerts = 1,
+	MapV3CollideInds = 2,
+	MapV3NonCollideVerts = 3,
+	MapV3NonCollideInds = 4
+};
 
-uint32_t InflateData(const char* buffer, uint32_t len, char* out_buffer, uint32_t out_len_max) {
-	z_stream zstream;
-	int zerror = 0;
-	int i;
+#pragma pack(1)
+struct MapV3Header
+{
+	uint32_t version;
+	uint32_t section_count;
+	float min[3];
+	float max[3];
+	float nc_min[3];
+	float nc_max[3];
+	uint32_t reserved[2];
+};
 
-	zstream.next_in = const_cast<unsigned char*>(reinterpret_cast<const unsigned char*>(buffer));
-	zstream.avail_in = len;
-	zstream.next_out = reinterpret_cast<unsigned char*>(out_buffer);;
-	zstream.avail_out = out_len_max;
-	zstream.zalloc = Z_NULL;
-	zstream.zfree = Z_NULL;
-	zstream.opaque = Z_NULL;
+struct MapV3Section
+{
+	uint32_t type;
+	uint32_t element_size;
+	uint64_t offset;
+	uint64_t count;
+};
+#pragma pack()
 
-	i = inflateInit2(&zstream, 15);
-	if (i != Z_OK) {
-		return 0;
-	}
+//v4 is the same flat geometry split into a grid of separately compressed chunks so only the parts in use
+//need to be resident: header, chunk table, then each chunk's deflated verts, inds, nc verts and nc inds
+#pragma pack(1)
+struct MapV4Header
+{
+	uint32_t version;
+	uint32_t chunk_count;
+	float chunk_size;
+	uint32_t reserved;
+	float min[3];
+	float max[3];
+	float nc_min[3];
+	float nc_max[3];
+};
 
-	zerror = inflate(&zstream, Z_FINISH);
-	if (zerror == Z_STREAM_END) {
-		inflateEnd(&zstream);
-		return zstream.total_out;
-	}
-	else {
-		if (zerror == -4 && zstream.msg == 0)
-		{
-			return 0;
-		}
+struct MapV4Chunk
+{
+	int32_t grid_x;
+	int32_t grid_y;
+	float min[3];
+	float max[3];
+	uint64_t offset;
+	uint32_t compressed_size;
+	uint32_t vert_count;
+	uint32_t ind_count;
+	uint32_t nc_vert_count;
+	uint32_t nc_ind_count;
+	uint32_t reserved;
+};
+#pragma pack()
 
-		zerror = inflateEnd(&zstream);
-		return 0;
-	}
-}
+//v2 chunked is the v2 payload deflated as independent chunks so they can be inflated in parallel:
+//version, chunk count, total payload size, a size pair per chunk, then the chunks back to back
+#pragma pack(1)
+struct MapV2ChunkedHeader
+{
+	uint32_t chunk_count;
+	uint32_t payload_size;
+};
+
+struct MapV2PayloadChunk
+{
+	uint32_t compressed_size;
+	uint32_t uncompressed_size;
+};
+#pragma pack()
+
+static_assert(sizeof(glm::vec3) == sizeof(float) * 3, "v3 maps store glm::vec3 as three packed floats");
+static_assert(sizeof(MapV3Header) % MAP_V3_ALIGNMENT == 0, "v3 header must keep the section table aligned");
 
 struct ZoneMap::impl
 {
@@ -54,6 +120,40 @@ struct ZoneMap::impl
 	std::vector<unsigned int> nc_inds;
 	glm::vec3 nc_min;
 	glm::vec3 nc_max;
+
+	//placeables, one copy of each model split by collidability and a transform per placement
+	std::vector<EQEmu::InstancedModel> models;
+	std::vector<EQEmu::InstancedModel> nc_models;
+	std::vector<EQEmu::MeshInstance> instances;
+
+	uint32_t load_flags;
+
+	//v3 maps are used in place, the views point into the mapping instead of the vectors above
+	std::unique_ptr<EQEmu::MemoryMappedFile> mapped;
+	EQEmu::Span<const glm::vec3> mapped_verts;
+	EQEmu::Span<const unsigned int> mapped_inds;
+	EQEmu::Span<const glm::vec3> mapped_nc_verts;
+	EQEmu::Span<const unsigned int> mapped_nc_inds;
+
+	//v4 chunks are read from the file as they're asked for, the records say where each one is
+	std::string chunk_file;
+	std::vector<ZoneMap::Chunk> chunks;
+	std::vector<MapV4Chunk> chunk_records;
+	float weld_epsilon;
+};
+
+struct ZoneMap::FlatGeometry
+{
+	EQEmu::Span<const glm::vec3> verts;
+	EQEmu::Span<const unsigned int> inds;
+	EQEmu::Span<const glm::vec3> nc_verts;
+	EQEmu::Span<const unsigned int> nc_inds;
+
+	//only used when there were instances to expand
+	std::vector<glm::vec3> flat_verts;
+	std::vector<unsigned int> flat_inds;
+	std::vector<glm::vec3> flat_nc_verts;
+	std::vector<unsigned int> flat_nc_inds;
 };
 
 ZoneMap::ZoneMap() {
@@ -63,20 +163,28 @@ ZoneMap::ZoneMap() {
 	imp->max = glm::vec3(0.0f);
 	imp->nc_min = glm::vec3(0.0f);
 	imp->nc_max = glm::vec3(0.0f);
+	imp->load_flags = MapLoadAll;
+	imp->weld_epsilon = -1.0f;
 }
 
 ZoneMap::~ZoneMap() {
 	delete imp;
 }
 
-ZoneMap *ZoneMap::LoadMapFile(std::string file) {
+ZoneMap *ZoneMap::LoadMapFile(std::string file, uint32_t flags) {
 	std::string filename = Config::Instance().GetPath("base", "maps/base") + "/";
 	std::transform(file.begin(), file.end(), file.begin(), ::tolower);
 	filename += file;
 	filename += ".map";
 
 	ZoneMap *m = new ZoneMap();
-	if (m->Load(filename)) {
+	if (m->Load(filename, flags)) {
+		//welding is opt in, without a configured epsilon the mesh is left as stored
+		float weld = Config::Instance().GetWeldEpsilon(-1.0f);
+		if (weld >= 0.0f) {
+			m->Weld(weld);
+		}
+
 		return m;
 	}
 
@@ -84,7 +192,9 @@ ZoneMap *ZoneMap::LoadMapFile(std::string file) {
 	return nullptr;
 }
 
-bool ZoneMap::Load(std::string filename) {
+bool ZoneMap::Load(std::string filename, uint32_t flags) {
+	imp->load_flags = flags;
+
 	FILE *f = fopen(filename.c_str(), "rb");
 	if(f) {
 		uint32_t version;
@@ -101,6 +211,17 @@ bool ZoneMap::Load(std::string filename) {
 			bool v = LoadV2(f);
 			fclose(f);
 			return v;
+		} else if(version == MAP_V2_CHUNKED_VERSION) {
+			bool v = LoadV2Chunked(f);
+			fclose(f);
+			return v;
+		} else if(version == MAP_V3_VERSION) {
+			fclose(f);
+			return LoadV3(filename);
+		} else if(version == MAP_V4_VERSION) {
+			bool v = LoadV4(f, filename);
+			fclose(f);
+			return v;
 		} else {
 			fclose(f);
 			return false;
@@ -126,6 +247,11 @@ bool ZoneMap::LoadV1(FILE *f) {
 	if(fread(&facelist_count, sizeof(facelist_count), 1, f) != 1) {
 		return false;
 	}
+
+	//v1 is all collidable, there's nothing else to load
+	if (!(imp->load_flags & MapLoadCollidable)) {
+		return true;
+	}
 	
 	for(uint32_t i = 0; i < face_count; ++i) {
 		glm::vec3 a;
@@ -194,648 +320,1585 @@ bool ZoneMap::LoadV1(FILE *f) {
 	return true;
 }
 
-struct ModelEntry
+//the v2 body comes either from memory (azone baking) or straight off disk, in the second case it is
+//inflated a window at a time so the whole payload is never held at once. Every read is checked
+//against the inflated size the header claims so a short or corrupt file fails instead of overrunning
+class ZoneMap::PayloadReader
 {
-	struct Poly
-	{
-		uint32_t v1, v2, v3;
-		uint8_t vis;
-	};
-	std::vector<glm::vec3> verts;
-	std::vector<Poly> polys;
-};
-
-bool ZoneMap::LoadV2(FILE *f) {
-	uint32_t data_size;
-	if (fread(&data_size, sizeof(data_size), 1, f) != 1) {
-		return false;
+public:
+	PayloadReader(const char *data, size_t size) : data(data), file(nullptr), remaining(size), compressed_left(0),
+		window_pos(0), window_len(0), initialized(false), next_chunk(0) {
 	}
 
-	uint32_t buffer_size;
-	if (fread(&buffer_size, sizeof(buffer_size), 1, f) != 1) {
-		return false;
+	PayloadReader(FILE *f, uint32_t data_size, uint32_t buffer_size) : data(nullptr), file(f), remaining(buffer_size),
+		compressed_left(data_size), window_pos(0), window_len(0), initialized(false), next_chunk(0) {
+		memset(&zstream, 0, sizeof(zstream));
+		initialized = inflateInit2(&zstream, 15) == Z_OK;
+		input.resize(MAP_V2_STREAM_WINDOW);
+		window.resize(MAP_V2_STREAM_WINDOW);
 	}
 
-	std::vector<char> data;
-	data.resize(data_size);
-	if (fread(&data[0], data_size, 1, f) != 1) {
-		return false;
+	//chunked payloads are inflated a batch of chunks at a time, each chunk on its own thread
+	PayloadReader(FILE *f, std::vector<MapV2PayloadChunk> &table, uint32_t payload_size) : data(nullptr), file(f),
+		remaining(payload_size), compressed_left(0), window_pos(0), window_len(0), initialized(false), next_chunk(0) {
+		chunks.swap(table);
 	}
 
-	std::vector<char> buffer;
-	buffer.resize(buffer_size);
-	uint32_t v = InflateData(&data[0], data_size, &buffer[0], buffer_size);
-
-	char *buf = &buffer[0];
-	uint32_t vert_count;
-	uint32_t ind_count;
-	uint32_t nc_vert_count;
-	uint32_t nc_ind_count;
-	uint32_t model_count;
-	uint32_t plac_count;
-	uint32_t plac_group_count;
-	uint32_t tile_count;
-	uint32_t quads_per_tile;
-	float units_per_vertex;
-
-	vert_count = *(uint32_t*)buf;
-	buf += sizeof(uint32_t);
-
-	ind_count = *(uint32_t*)buf;
-	buf += sizeof(uint32_t);
-
-	nc_vert_count = *(uint32_t*)buf;
-	buf += sizeof(uint32_t);
-
-	nc_ind_count = *(uint32_t*)buf;
-	buf += sizeof(uint32_t);
-
-	model_count = *(uint32_t*)buf;
-	buf += sizeof(uint32_t);
-
-	plac_count = *(uint32_t*)buf;
-	buf += sizeof(uint32_t);
+	~PayloadReader() {
+		if (initialized) {
+			inflateEnd(&zstream);
+		}
+	}
 
-	plac_group_count = *(uint32_t*)buf;
-	buf += sizeof(uint32_t);
+	size_t Remaining() const { return remaining; }
 
-	tile_count = *(uint32_t*)buf;
-	buf += sizeof(uint32_t);
+	bool Read(void *out, size_t len) {
+		if (len > remaining) {
+			return false;
+		}
 
-	quads_per_tile = *(uint32_t*)buf;
-	buf += sizeof(uint32_t);
+		char *dst = (char*)out;
+		if (data) {
+			memcpy(dst, data, len);
+			data += len;
+			remaining -= len;
+			return true;
+		}
 
-	units_per_vertex = *(float*)buf;
-	buf += sizeof(float);
+		size_t n = std::min(window_len - window_pos, len);
+		if (n > 0) {
+			memcpy(dst, &window[window_pos], n);
+			window_pos += n;
+			dst += n;
+			len -= n;
+			remaining -= n;
+		}
 
-	for (uint32_t i = 0; i < vert_count; ++i) {
-		float x;
-		float y;
-		float z;
+		if (len == 0) {
+			return true;
+		}
 
-		x = *(float*)buf;
-		buf += sizeof(float);
+		if (!chunks.empty()) {
+			return ReadChunks(dst, len);
+		}
 
-		y = *(float*)buf;
-		buf += sizeof(float);
+		//bulk arrays inflate straight into their destination, everything else goes through the window
+		if (len >= MAP_V2_STREAM_WINDOW) {
+			if (!Inflate(dst, len)) {
+				return false;
+			}
 
-		z = *(float*)buf;
-		buf += sizeof(float);
+			remaining -= len;
+			return true;
+		}
 
-		glm::vec3 vert(x, y, z);
+		size_t fill = std::min(window.size(), remaining);
+		if (!Inflate(&window[0], fill)) {
+			return false;
+		}
 
-		imp->verts.push_back(vert);
+		window_len = fill;
+		window_pos = len;
+		memcpy(dst, &window[0], len);
+		remaining -= len;
+		return true;
 	}
 
-	for (uint32_t i = 0; i < ind_count; ++i) {
-		uint32_t index;
-		index = *(uint32_t*)buf;
-		buf += sizeof(uint32_t);
-
-		imp->inds.push_back(index);
+	template<typename T>
+	bool ReadValue(T &v) {
+		return Read(&v, sizeof(T));
 	}
 
-	for (uint32_t i = 0; i < nc_vert_count; ++i) {
-		float x;
-		float y;
-		float z;
-
-		x = *(float*)buf;
-		buf += sizeof(float);
-
-		y = *(float*)buf;
-		buf += sizeof(float);
-
-		z = *(float*)buf;
-		buf += sizeof(float);
-
-		glm::vec3 vert(x, y, z);
+	//resizes only after checking the payload can actually hold that many elements
+	template<typename T>
+	bool ReadArray(std::vector<T> &out, uint32_t count) {
+		if ((uint64_t)count * sizeof(T) > remaining) {
+			return false;
+		}
 
-		imp->nc_verts.push_back(vert);
+		out.resize(count);
+		return count == 0 || Read(&out[0], count * sizeof(T));
 	}
 
-	for (uint32_t i = 0; i < nc_ind_count; ++i) {
-		uint32_t index;
-		index = *(uint32_t*)buf;
-		buf += sizeof(uint32_t);
-
-		imp->nc_inds.push_back(index);
-	}
+	//sections nobody asked for are still inflated to get past them, but never stored
+	bool Skip(size_t len) {
+		if (len > remaining) {
+			return false;
+		}
 
-	std::map<std::string, std::shared_ptr<ModelEntry>> models;
-	for (uint32_t i = 0; i < model_count; ++i) {
-		std::shared_ptr<ModelEntry> me(new ModelEntry);
-		std::string name = buf;
-		buf += name.length() + 1;
+		if (data) {
+			data += len;
+			remaining -= len;
+			return true;
+		}
 
-		uint32_t vert_count = *(uint32_t*)buf;
-		buf += sizeof(uint32_t);
+		char scratch[4096];
+		while (len > 0) {
+			size_t n = std::min(len, sizeof(scratch));
+			if (!Read(scratch, n)) {
+				return false;
+			}
 
-		uint32_t poly_count = *(uint32_t*)buf;
-		buf += sizeof(uint32_t);
+			len -= n;
+		}
 
-		me->verts.resize(vert_count);
-		for (uint32_t j = 0; j < vert_count; ++j) {
-			float x = *(float*)buf;
-			buf += sizeof(float);
-			float y = *(float*)buf;
-			buf += sizeof(float);
-			float z = *(float*)buf;
-			buf += sizeof(float);
+		return true;
+	}
 
-			me->verts[j] = glm::vec3(x, y, z);
-		}
+	bool ReadString(std::string &out) {
+		out.clear();
+		char c;
+		while (Read(&c, 1)) {
+			if (c == 0) {
+				return true;
+			}
 
-		me->polys.resize(poly_count);
-		for (uint32_t j = 0; j < poly_count; ++j) {
-			uint32_t v1 = *(uint32_t*)buf;
-			buf += sizeof(uint32_t);
-			uint32_t v2 = *(uint32_t*)buf;
-			buf += sizeof(uint32_t);
-			uint32_t v3 = *(uint32_t*)buf;
-			buf += sizeof(uint32_t);
-			uint8_t vis = *(uint8_t*)buf;
-			buf += sizeof(uint8_t);
-
-			ModelEntry::Poly p;
-			p.v1 = v1;
-			p.v2 = v2;
-			p.v3 = v3;
-			p.vis = vis;
-			me->polys[j] = p;
+			out.push_back(c);
 		}
 
-		models[name] = me;
+		return false;
 	}
+private:
+	//picks up to MAP_V2_CHUNK_BATCH_BYTES worth of chunks, when limit is set only whole chunks that fit in it
+	size_t BatchChunks(size_t limit, size_t &bytes) const {
+		size_t count = 0;
+		bytes = 0;
+		while (next_chunk + count < chunks.size()) {
+			size_t sz = chunks[next_chunk + count].uncompressed_size;
+			if (limit > 0 ? bytes + sz > limit : (count > 0 && bytes + sz > MAP_V2_CHUNK_BATCH_BYTES)) {
+				break;
+			}
 
-	for (uint32_t i = 0; i < plac_count; ++i) {
-		std::string name = buf;
-		buf += name.length() + 1;
-
-		float x = *(float*)buf;
-		buf += sizeof(float);
-		float y = *(float*)buf;
-		buf += sizeof(float);
-		float z = *(float*)buf;
-		buf += sizeof(float);
-
-		float x_rot = *(float*)buf;
-		buf += sizeof(float);
-		float y_rot = *(float*)buf;
-		buf += sizeof(float);
-		float z_rot = *(float*)buf;
-		buf += sizeof(float);
-
-		float x_scale = *(float*)buf;
-		buf += sizeof(float);
-		float y_scale = *(float*)buf;
-		buf += sizeof(float);
-		float z_scale = *(float*)buf;
-		buf += sizeof(float);
-
-		if (models.count(name) == 0)
-			continue;
+			bytes += sz;
+			++count;
+		}
 
-		auto model = models[name];
-		auto &mod_polys = model->polys;
-		auto &mod_verts = model->verts;
-		for (uint32_t j = 0; j < mod_polys.size(); ++j) {
-			auto &current_poly = mod_polys[j];
-			auto v1 = mod_verts[current_poly.v1];
-			auto v2 = mod_verts[current_poly.v2];
-			auto v3 = mod_verts[current_poly.v3];
+		return count;
+	}
 
-			RotateVertex(v1, x_rot, y_rot, z_rot);
-			RotateVertex(v2, x_rot, y_rot, z_rot);
-			RotateVertex(v3, x_rot, y_rot, z_rot);
+	bool InflateChunks(size_t count, char *out) {
+		size_t in_size = 0;
+		for (size_t i = 0; i < count; ++i) {
+			in_size += chunks[next_chunk + i].compressed_size;
+		}
 
-			ScaleVertex(v1, x_scale, y_scale, z_scale);
-			ScaleVertex(v2, x_scale, y_scale, z_scale);
-			ScaleVertex(v3, x_scale, y_scale, z_scale);
+		input.resize(in_size);
+		if (in_size > 0 && fread(&input[0], 1, in_size, file) != in_size) {
+			return false;
+		}
 
-			TranslateVertex(v1, x, y, z);
-			TranslateVertex(v2, x, y, z);
-			TranslateVertex(v3, x, y, z);
+		std::vector<size_t> in_offsets(count);
+		std::vector<size_t> out_offsets(count);
+		size_t in_pos = 0;
+		size_t out_pos = 0;
+		for (size_t i = 0; i < count; ++i) {
+			in_offsets[i] = in_pos;
+			out_offsets[i] = out_pos;
+			in_pos += chunks[next_chunk + i].compressed_size;
+			out_pos += chunks[next_chunk + i].uncompressed_size;
+		}
 
-			float t = v1.x;
-			v1.x = v1.y;
-			v1.y = t;
+		std::atomic<bool> failed(false);
+		const MapV2PayloadChunk *batch = &chunks[next_chunk];
+		const char *in = (const char*)input.data();
+		EQEmu::ThreadPool::Instance().ParallelFor(count, [&](size_t i) {
+			auto &c = batch[i];
+			if (EQEmu::InflateData(in + in_offsets[i], c.compressed_size, out + out_offsets[i], c.uncompressed_size) != c.uncompressed_size) {
+				failed = true;
+			}
+		});
 
-			t = v2.x;
-			v2.x = v2.y;
-			v2.y = t;
+		next_chunk += count;
+		return !failed;
+	}
 
-			t = v3.x;
-			v3.x = v3.y;
-			v3.y = t;
+	bool ReadChunks(char *dst, size_t len) {
+		while (len > 0) {
+			//whole chunks that land inside the read inflate straight into the destination
+			size_t bytes;
+			size_t count = BatchChunks(std::min(len, (size_t)MAP_V2_CHUNK_BATCH_BYTES), bytes);
+			if (count > 0) {
+				if (!InflateChunks(count, dst)) {
+					return false;
+				}
 
-			if (current_poly.vis != 0) {
-				imp->verts.push_back(v1);
-				imp->verts.push_back(v2);
-				imp->verts.push_back(v3);
+				dst += bytes;
+				len -= bytes;
+				remaining -= bytes;
+				continue;
+			}
 
-				imp->inds.push_back((uint32_t)imp->verts.size() - 3);
-				imp->inds.push_back((uint32_t)imp->verts.size() - 2);
-				imp->inds.push_back((uint32_t)imp->verts.size() - 1);
-			} else {
-				imp->nc_verts.push_back(v1);
-				imp->nc_verts.push_back(v2);
-				imp->nc_verts.push_back(v3);
+			count = BatchChunks(0, bytes);
+			if (count == 0) {
+				return false;
+			}
 
-				imp->nc_inds.push_back((uint32_t)imp->nc_verts.size() - 3);
-				imp->nc_inds.push_back((uint32_t)imp->nc_verts.size() - 2);
-				imp->nc_inds.push_back((uint32_t)imp->nc_verts.size() - 1);
+			window.resize(std::max(window.size(), bytes));
+			if (!InflateChunks(count, &window[0])) {
+				return false;
 			}
+
+			window_len = bytes;
+			window_pos = std::min(len, bytes);
+			memcpy(dst, &window[0], window_pos);
+			dst += window_pos;
+			len -= window_pos;
+			remaining -= window_pos;
 		}
+
+		return true;
 	}
 
-	for (uint32_t i = 0; i < plac_group_count; ++i) {
-		float x = *(float*)buf;
-		buf += sizeof(float);
-		float y = *(float*)buf;
-		buf += sizeof(float);
-		float z = *(float*)buf;
-		buf += sizeof(float);
-
-		float x_rot = *(float*)buf;
-		buf += sizeof(float);
-		float y_rot = *(float*)buf;
-		buf += sizeof(float);
-		float z_rot = *(float*)buf;
-		buf += sizeof(float);
-
-		float x_scale = *(float*)buf;
-		buf += sizeof(float);
-		float y_scale = *(float*)buf;
-		buf += sizeof(float);
-		float z_scale = *(float*)buf;
-		buf += sizeof(float);
-
-		float x_tile = *(float*)buf;
-		buf += sizeof(float);
-		float y_tile = *(float*)buf;
-		buf += sizeof(float);
-		float z_tile = *(float*)buf;
-		buf += sizeof(float);
-
-		uint32_t p_count = *(uint32_t*)buf;
-		buf += sizeof(uint32_t);
-
-		for (uint32_t j = 0; j < p_count; ++j) {
-			std::string name = buf;
-			buf += name.length() + 1;
-
-			float p_x = *(float*)buf;
-			buf += sizeof(float);
-			float p_y = *(float*)buf;
-			buf += sizeof(float);
-			float p_z = *(float*)buf;
-			buf += sizeof(float);
-
-			float p_x_rot = *(float*)buf * 3.14159f / 180;
-			buf += sizeof(float);
-			float p_y_rot = *(float*)buf * 3.14159f / 180;
-			buf += sizeof(float);
-			float p_z_rot = *(float*)buf * 3.14159f / 180;
-			buf += sizeof(float);
-
-			float p_x_scale = *(float*)buf;
-			buf += sizeof(float);
-			float p_y_scale = *(float*)buf;
-			buf += sizeof(float);
-			float p_z_scale = *(float*)buf;
-			buf += sizeof(float);
-
-			if (models.count(name) == 0)
-				continue;
+	bool Inflate(char *out, size_t len) {
+		if (!initialized) {
+			return false;
+		}
 
-			auto &model = models[name];
+		zstream.next_out = reinterpret_cast<unsigned char*>(out);
+		while (len > 0) {
+			uInt chunk = (uInt)std::min(len, (size_t)0x40000000);
+			zstream.avail_out = chunk;
+			while (zstream.avail_out > 0) {
+				if (zstream.avail_in == 0) {
+					if (compressed_left == 0) {
+						return false;
+					}
+
+					size_t want = std::min((size_t)compressed_left, input.size());
+					if (fread(&input[0], 1, want, file) != want) {
+						return false;
+					}
+
+					compressed_left -= (uint32_t)want;
+					zstream.next_in = &input[0];
+					zstream.avail_in = (uInt)want;
+				}
 
-			for (size_t k = 0; k < model->polys.size(); ++k) {
-				auto &poly = model->polys[k];
-				glm::vec3 v1, v2, v3;
+				int err = inflate(&zstream, Z_NO_FLUSH);
+				if (err == Z_STREAM_END) {
+					if (zstream.avail_out != 0) {
+						return false;
+					}
+					break;
+				}
 
-				v1 = model->verts[poly.v1];
-				v2 = model->verts[poly.v2];
-				v3 = model->verts[poly.v3];
+				if (err != Z_OK) {
+					return false;
+				}
+			}
 
-				ScaleVertex(v1, p_x_scale, p_y_scale, p_z_scale);
-				ScaleVertex(v2, p_x_scale, p_y_scale, p_z_scale);
-				ScaleVertex(v3, p_x_scale, p_y_scale, p_z_scale);
+			len -= chunk;
+		}
 
-				TranslateVertex(v1, p_x, p_y, p_z);
-				TranslateVertex(v2, p_x, p_y, p_z);
-				TranslateVertex(v3, p_x, p_y, p_z);
+		return true;
+	}
 
-				RotateVertex(v1, x_rot * 3.14159f / 180.0f, 0, 0);
-				RotateVertex(v2, x_rot * 3.14159f / 180.0f, 0, 0);
-				RotateVertex(v3, x_rot * 3.14159f / 180.0f, 0, 0);
+	const char *data;
+	FILE *file;
+	size_t remaining;
+	uint32_t compressed_left;
+	z_stream zstream;
+	std::vector<unsigned char> input;
+	std::vector<char> window;
+	size_t window_pos;
+	size_t window_len;
+	bool initialized;
+	std::vector<MapV2PayloadChunk> chunks;
+	size_t next_chunk;
+};
 
-				RotateVertex(v1, 0, y_rot * 3.14159f / 180.0f, 0);
-				RotateVertex(v2, 0, y_rot * 3.14159f / 180.0f, 0);
-				RotateVertex(v3, 0, y_rot * 3.14159f / 180.0f, 0);
+struct ModelEntry
+{
+	struct Poly
+	{
+		uint32_t v1, v2, v3;
+		uint8_t vis;
+	};
+	std::vector<glm::vec3> verts;
+	std::vector<Poly> polys;
+};
 
-				glm::vec3 correction(p_x, p_y, p_z);
+struct PlaceableEntry
+{
+	std::string name;
+	float values[9]; //x, y, z, rotation, scale
+};
 
-				RotateVertex(correction, x_rot * 3.14159f / 180.0f, 0, 0);
+struct PlaceableGroupEntry
+{
+	float values[12]; //x, y, z, rotation, scale, tile
+	std::vector<PlaceableEntry> placeables;
+};
 
-				TranslateVertex(v1, -correction.x, -correction.y, -correction.z);
-				TranslateVertex(v2, -correction.x, -correction.y, -correction.z);
-				TranslateVertex(v3, -correction.x, -correction.y, -correction.z);
+struct TerrainTileEntry
+{
+	uint8_t flat;
+	float x, y, z;
+	std::vector<uint8_t> flags;
+	std::vector<float> floats;
 
-				RotateVertex(v1, p_x_rot, 0, 0);
-				RotateVertex(v2, p_x_rot, 0, 0);
-				RotateVertex(v3, p_x_rot, 0, 0);
+	//expanded on its own so tiles can be done in parallel, inds start from the tile's first vert
+	std::vector<glm::vec3> verts;
+	std::vector<unsigned int> inds;
+};
 
-				RotateVertex(v1, 0, -p_y_rot, 0);
-				RotateVertex(v2, 0, -p_y_rot, 0);
-				RotateVertex(v3, 0, -p_y_rot, 0);
+//pulls the collidable or non-collidable half of a model out with only the verts it uses
+static void SplitModel(const ModelEntry &model, bool collidable, EQEmu::InstancedModel &out) {
+	std::vector<uint32_t> remap(model.verts.size(), 0xFFFFFFFFu);
+	for (auto &poly : model.polys) {
+		if ((poly.vis != 0) != collidable) {
+			continue;
+		}
 
-				RotateVertex(v1, 0, 0, p_z_rot);
-				RotateVertex(v2, 0, 0, p_z_rot);
-				RotateVertex(v3, 0, 0, p_z_rot);
+		const uint32_t v[3] = { poly.v1, poly.v2, poly.v3 };
+		for (int i = 0; i < 3; ++i) {
+			if (remap[v[i]] == 0xFFFFFFFFu) {
+				remap[v[i]] = (uint32_t)out.verts.size();
+				out.verts.push_back(model.verts[v[i]]);
+			}
 
-				TranslateVertex(v1, correction.x, correction.y, correction.z);
-				TranslateVertex(v2, correction.x, correction.y, correction.z);
-				TranslateVertex(v3, correction.x, correction.y, correction.z);
+			out.inds.push_back(remap[v[i]]);
+		}
+	}
+}
 
-				RotateVertex(v1, 0, 0, z_rot * 3.14159f / 180.0f);
-				RotateVertex(v2, 0, 0, z_rot * 3.14159f / 180.0f);
-				RotateVertex(v3, 0, 0, z_rot * 3.14159f / 180.0f);
+static void ExtendBounds(const glm::vec3 &vert, glm::vec3 &min, glm::vec3 &max, bool ignore_underworld) {
+	if(vert.x < min.x) {
+		min.x = vert.x;
+	}
 
-				ScaleVertex(v1, x_scale, y_scale, z_scale);
-				ScaleVertex(v2, x_scale, y_scale, z_scale);
-				ScaleVertex(v3, x_scale, y_scale, z_scale);
+	if(vert.y < min.y && (!ignore_underworld || vert.y > -15000)) {
+		min.y = vert.y;
+	}
 
-				TranslateVertex(v1, x_tile, y_tile, z_tile);
-				TranslateVertex(v2, x_tile, y_tile, z_tile);
-				TranslateVertex(v3, x_tile, y_tile, z_tile);
+	if(vert.z < min.z) {
+		min.z = vert.z;
+	}
 
-				TranslateVertex(v1, x, y, z);
-				TranslateVertex(v2, x, y, z);
-				TranslateVertex(v3, x, y, z);
+	if(vert.x > max.x) {
+		max.x = vert.x;
+	}
 
-				float t = v1.x;
-				v1.x = v1.y;
-				v1.y = t;
+	if(vert.y > max.y) {
+		max.y = vert.y;
+	}
 
-				t = v2.x;
-				v2.x = v2.y;
-				v2.y = t;
+	if(vert.z > max.z) {
+		max.z = vert.z;
+	}
+}
 
-				t = v3.x;
-				v3.x = v3.y;
-				v3.y = t;
+//merges verts within epsilon of each other using a hash of epsilon sized cells, triangles that
+//collapse as a result are dropped. An epsilon of 0 merges exact duplicates only
+static void WeldVertices(std::vector<glm::vec3> &verts, std::vector<unsigned int> &inds, float epsilon) {
+	const uint32_t none = 0xFFFFFFFFu;
+	const float inv_cell = epsilon > 0.0f ? 1.0f / epsilon : 1.0f;
+	const float epsilon_sq = epsilon * epsilon;
+	const int search = epsilon > 0.0f ? 1 : 0;
 
-				if (poly.vis != 0) {
-					imp->verts.push_back(v1);
-					imp->verts.push_back(v2);
-					imp->verts.push_back(v3);
+	auto cell_key = [](int64_t x, int64_t y, int64_t z) {
+		return ((uint64_t)(x & 0x1FFFFF) << 42) | ((uint64_t)(y & 0x1FFFFF) << 21) | (uint64_t)(z & 0x1FFFFF);
+	};
 
-					imp->inds.push_back((uint32_t)imp->verts.size() - 3);
-					imp->inds.push_back((uint32_t)imp->verts.size() - 2);
-					imp->inds.push_back((uint32_t)imp->verts.size() - 1);
-				} else {
-					imp->nc_verts.push_back(v1);
-					imp->nc_verts.push_back(v2);
-					imp->nc_verts.push_back(v3);
+	//each cell points at its newest welded vert, next chains back through the rest
+	std::unordered_map<uint64_t, uint32_t> cells;
+	std::vector<uint32_t> next;
+	std::vector<glm::vec3> welded;
+	std::vector<uint32_t> remap(verts.size(), none);
+	cells.reserve(verts.size());
+	welded.reserve(verts.size());
+	next.reserve(verts.size());
+
+	auto weld = [&](uint32_t idx) {
+		if (remap[idx] != none) {
+			return remap[idx];
+		}
 
-					imp->nc_inds.push_back((uint32_t)imp->nc_verts.size() - 3);
-					imp->nc_inds.push_back((uint32_t)imp->nc_verts.size() - 2);
-					imp->nc_inds.push_back((uint32_t)imp->nc_verts.size() - 1);
+		auto &v = verts[idx];
+		uint32_t found = none;
+		bool finite = std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+		int64_t cx = 0, cy = 0, cz = 0;
+		if (finite) {
+			cx = (int64_t)floor(v.x * inv_cell);
+			cy = (int64_t)floor(v.y * inv_cell);
+			cz = (int64_t)floor(v.z * inv_cell);
+			for (int dx = -search; dx <= search && found == none; ++dx) {
+				for (int dy = -search; dy <= search && found == none; ++dy) {
+					for (int dz = -search; dz <= search && found == none; ++dz) {
+						auto iter = cells.find(cell_key(cx + dx, cy + dy, cz + dz));
+						if (iter == cells.end()) {
+							continue;
+						}
+
+						for (uint32_t j = iter->second; j != none; j = next[j]) {
+							glm::vec3 d = welded[j] - v;
+							if (glm::dot(d, d) <= epsilon_sq) {
+								found = j;
+								break;
+							}
+						}
+					}
 				}
 			}
 		}
-	}
 
-	uint32_t ter_quad_count = (quads_per_tile * quads_per_tile);
-	uint32_t ter_vert_count = ((quads_per_tile + 1) * (quads_per_tile + 1));
-	std::vector<uint8_t> flags;
-	std::vector<float> floats;
-	flags.resize(ter_quad_count);
-	floats.resize(ter_vert_count);
-	for (uint32_t i = 0; i < tile_count; ++i) {
-		bool flat;
-		flat = *(bool*)buf;
-		buf += sizeof(bool);
+		if (found == none) {
+			found = (uint32_t)welded.size();
+			welded.push_back(v);
+			next.push_back(none);
+			if (finite) {
+				uint64_t key = cell_key(cx, cy, cz);
+				auto iter = cells.find(key);
+				if (iter != cells.end()) {
+					next[found] = iter->second;
+					iter->second = found;
+				}
+				else {
+					cells[key] = found;
+				}
+			}
+		}
 
-		float x;
-		x = *(float*)buf;
-		buf += sizeof(float);
+		remap[idx] = found;
+		return found;
+	};
 
-		float y;
-		y = *(float*)buf;
-		buf += sizeof(float);
+	std::vector<unsigned int> welded_inds;
+	welded_inds.reserve(inds.size());
+	for (size_t i = 0; i + 2 < inds.size(); i += 3) {
+		if (inds[i] >= verts.size() || inds[i + 1] >= verts.size() || inds[i + 2] >= verts.size()) {
+			continue;
+		}
 
-		if (flat) {
-			float z;
-			z = *(float*)buf;
-			buf += sizeof(float);
+		uint32_t a = weld(inds[i]);
+		uint32_t b = weld(inds[i + 1]);
+		uint32_t c = weld(inds[i + 2]);
+		if (a == b || b == c || a == c) {
+			continue;
+		}
 
-			float QuadVertex1X = x;
-			float QuadVertex1Y = y;
-			float QuadVertex1Z = z;
+		welded_inds.push_back(a);
+		welded_inds.push_back(b);
+		welded_inds.push_back(c);
+	}
 
-			float QuadVertex2X = QuadVertex1X + (quads_per_tile * units_per_vertex);
-			float QuadVertex2Y = QuadVertex1Y;
-			float QuadVertex2Z = QuadVertex1Z;
+	verts.swap(welded);
+	inds.swap(welded_inds);
+}
 
-			float QuadVertex3X = QuadVertex2X;
-			float QuadVertex3Y = QuadVertex1Y + (quads_per_tile * units_per_vertex);
-			float QuadVertex3Z = QuadVertex1Z;
+static void ExpandTerrainTile(TerrainTileEntry &tile, uint32_t quads_per_tile, float units_per_vertex) {
+	tile.verts.clear();
+	tile.inds.clear();
 
-			float QuadVertex4X = QuadVertex1X;
-			float QuadVertex4Y = QuadVertex3Y;
-			float QuadVertex4Z = QuadVertex1Z;
+	if (tile.flat) {
+		float QuadVertex1X = tile.x;
+		float QuadVertex1Y = tile.y;
+		float QuadVertex1Z = tile.z;
 
-			uint32_t current_vert = (uint32_t)imp->verts.size() + 3;
-			imp->verts.push_back(glm::vec3(QuadVertex1X, QuadVertex1Y, QuadVertex1Z));
-			imp->verts.push_back(glm::vec3(QuadVertex2X, QuadVertex2Y, QuadVertex2Z));
-			imp->verts.push_back(glm::vec3(QuadVertex3X, QuadVertex3Y, QuadVertex3Z));
-			imp->verts.push_back(glm::vec3(QuadVertex4X, QuadVertex4Y, QuadVertex4Z));
+		float QuadVertex2X = QuadVertex1X + (quads_per_tile * units_per_vertex);
+		float QuadVertex2Y = QuadVertex1Y;
+		float QuadVertex2Z = QuadVertex1Z;
 
-			imp->inds.push_back(current_vert - 0);
-			imp->inds.push_back(current_vert - 1);
-			imp->inds.push_back(current_vert - 2);
+		float QuadVertex3X = QuadVertex2X;
+		float QuadVertex3Y = QuadVertex1Y + (quads_per_tile * units_per_vertex);
+		float QuadVertex3Z = QuadVertex1Z;
 
-			imp->inds.push_back(current_vert - 2);
-			imp->inds.push_back(current_vert - 3);
-			imp->inds.push_back(current_vert - 0);
-		}
-		else {
-			//read flags
-			for (uint32_t j = 0; j < ter_quad_count; ++j) {
-				uint8_t f;
-				f = *(uint8_t*)buf;
-				buf += sizeof(uint8_t);
+		float QuadVertex4X = QuadVertex1X;
+		float QuadVertex4Y = QuadVertex3Y;
+		float QuadVertex4Z = QuadVertex1Z;
 
-				flags[j] = f;
-			}
+		uint32_t current_vert = (uint32_t)tile.verts.size() + 3;
+		tile.verts.push_back(glm::vec3(QuadVertex1X, QuadVertex1Y, QuadVertex1Z));
+		tile.verts.push_back(glm::vec3(QuadVertex2X, QuadVertex2Y, QuadVertex2Z));
+		tile.verts.push_back(glm::vec3(QuadVertex3X, QuadVertex3Y, QuadVertex3Z));
+		tile.verts.push_back(glm::vec3(QuadVertex4X, QuadVertex4Y, QuadVertex4Z));
 
-			//read floats
-			for (uint32_t j = 0; j < ter_vert_count; ++j) {
-				float f;
-				f = *(float*)buf;
-				buf += sizeof(float);
+		tile.inds.push_back(current_vert - 0);
+		tile.inds.push_back(current_vert - 1);
+		tile.inds.push_back(current_vert - 2);
 
-				floats[j] = f;
+		tile.inds.push_back(current_vert - 2);
+		tile.inds.push_back(current_vert - 3);
+		tile.inds.push_back(current_vert - 0);
+	}
+	else {
+		uint32_t ter_quad_count = (quads_per_tile * quads_per_tile);
+		int row_number = -1;
+		std::map<std::tuple<float, float, float>, uint32_t> cur_verts;
+		for (uint32_t quad = 0; quad < ter_quad_count; ++quad) {
+			if ((quad % quads_per_tile) == 0) {
+				++row_number;
 			}
 
-			int row_number = -1;
-			std::map<std::tuple<float, float, float>, uint32_t> cur_verts;
-			for (uint32_t quad = 0; quad < ter_quad_count; ++quad) {
-				if ((quad % quads_per_tile) == 0) {
-					++row_number;
-				}
-
-				if (flags[quad] & 0x01)
-					continue;
-
-				float QuadVertex1X = x + (row_number * units_per_vertex);
-				float QuadVertex1Y = y + (quad % quads_per_tile) * units_per_vertex;
-				float QuadVertex1Z = floats[quad + row_number];
+			if (tile.flags[quad] & 0x01)
+				continue;
 
-				float QuadVertex2X = QuadVertex1X + units_per_vertex;
-				float QuadVertex2Y = QuadVertex1Y;
-				float QuadVertex2Z = floats[quad + row_number + quads_per_tile + 1];
+			float QuadVertex1X = tile.x + (row_number * units_per_vertex);
+			float QuadVertex1Y = tile.y + (quad % quads_per_tile) * units_per_vertex;
+			float QuadVertex1Z = tile.floats[quad + row_number];
 
-				float QuadVertex3X = QuadVertex1X + units_per_vertex;
-				float QuadVertex3Y = QuadVertex1Y + units_per_vertex;
-				float QuadVertex3Z = floats[quad + row_number + quads_per_tile + 2];
+			float QuadVertex2X = QuadVertex1X + units_per_vertex;
+			float QuadVertex2Y = QuadVertex1Y;
+			float QuadVertex2Z = tile.floats[quad + row_number + quads_per_tile + 1];
 
-				float QuadVertex4X = QuadVertex1X;
-				float QuadVertex4Y = QuadVertex1Y + units_per_vertex;
-				float QuadVertex4Z = floats[quad + row_number + 1];
+			float QuadVertex3X = QuadVertex1X + units_per_vertex;
+			float QuadVertex3Y = QuadVertex1Y + units_per_vertex;
+			float QuadVertex3Z = tile.floats[quad + row_number + quads_per_tile + 2];
 
-				uint32_t i1, i2, i3, i4;
-				std::tuple<float, float, float> t = std::make_tuple(QuadVertex1X, QuadVertex1Y, QuadVertex1Z);
-				auto iter = cur_verts.find(t);
-				if (iter != cur_verts.end()) {
-					i1 = iter->second;
-				}
-				else {
-					i1 = (uint32_t)imp->verts.size();
-					imp->verts.push_back(glm::vec3(QuadVertex1X, QuadVertex1Y, QuadVertex1Z));
-					cur_verts[std::make_tuple(QuadVertex1X, QuadVertex1Y, QuadVertex1Z)] = i1;
-				}
+			float QuadVertex4X = QuadVertex1X;
+			float QuadVertex4Y = QuadVertex1Y + units_per_vertex;
+			float QuadVertex4Z = tile.floats[quad + row_number + 1];
+
+			uint32_t i1, i2, i3, i4;
+			std::tuple<float, float, float> t = std::make_tuple(QuadVertex1X, QuadVertex1Y, QuadVertex1Z);
+			auto iter = cur_verts.find(t);
+			if (iter != cur_verts.end()) {
+				i1 = iter->second;
+			}
+			else {
+				i1 = (uint32_t)tile.verts.size();
+				tile.verts.push_back(glm::vec3(QuadVertex1X, QuadVertex1Y, QuadVertex1Z));
+				cur_verts[std::make_tuple(QuadVertex1X, QuadVertex1Y, QuadVertex1Z)] = i1;
+			}
 
-				t = std::make_tuple(QuadVertex2X, QuadVertex2Y, QuadVertex2Z);
-				iter = cur_verts.find(t);
-				if (iter != cur_verts.end()) {
-					i2 = iter->second;
-				}
-				else {
-					i2 = (uint32_t)imp->verts.size();
-					imp->verts.push_back(glm::vec3(QuadVertex2X, QuadVertex2Y, QuadVertex2Z));
-					cur_verts[std::make_tuple(QuadVertex2X, QuadVertex2Y, QuadVertex2Z)] = i2;
-				}
+			t = std::make_tuple(QuadVertex2X, QuadVertex2Y, QuadVertex2Z);
+			iter = cur_verts.find(t);
+			if (iter != cur_verts.end()) {
+				i2 = iter->second;
+			}
+			else {
+				i2 = (uint32_t)tile.verts.size();
+				tile.verts.push_back(glm::vec3(QuadVertex2X, QuadVertex2Y, QuadVertex2Z));
+				cur_verts[std::make_tuple(QuadVertex2X, QuadVertex2Y, QuadVertex2Z)] = i2;
+			}
 
-				t = std::make_tuple(QuadVertex3X, QuadVertex3Y, QuadVertex3Z);
-				iter = cur_verts.find(t);
-				if (iter != cur_verts.end()) {
-					i3 = iter->second;
-				}
-				else {
-					i3 = (uint32_t)imp->verts.size();
-					imp->verts.push_back(glm::vec3(QuadVertex3X, QuadVertex3Y, QuadVertex3Z));
-					cur_verts[std::make_tuple(QuadVertex3X, QuadVertex3Y, QuadVertex3Z)] = i3;
-				}
+			t = std::make_tuple(QuadVertex3X, QuadVertex3Y, QuadVertex3Z);
+			iter = cur_verts.find(t);
+			if (iter != cur_verts.end()) {
+				i3 = iter->second;
+			}
+			else {
+				i3 = (uint32_t)tile.verts.size();
+				tile.verts.push_back(glm::vec3(QuadVertex3X, QuadVertex3Y, QuadVertex3Z));
+				cur_verts[std::make_tuple(QuadVertex3X, QuadVertex3Y, QuadVertex3Z)] = i3;
+			}
 
-				t = std::make_tuple(QuadVertex4X, QuadVertex4Y, QuadVertex4Z);
-				iter = cur_verts.find(t);
-				if (iter != cur_verts.end()) {
-					i4 = iter->second;
-				}
-				else {
-					i4 = (uint32_t)imp->verts.size();
-					imp->verts.push_back(glm::vec3(QuadVertex4X, QuadVertex4Y, QuadVertex4Z));
-					cur_verts[std::make_tuple(QuadVertex4X, QuadVertex4Y, QuadVertex4Z)] = i4;
-				}
+			t = std::make_tuple(QuadVertex4X, QuadVertex4Y, QuadVertex4Z);
+			iter = cur_verts.find(t);
+			if (iter != cur_verts.end()) {
+				i4 = iter->second;
+			}
+			else {
+				i4 = (uint32_t)tile.verts.size();
+				tile.verts.push_back(glm::vec3(QuadVertex4X, QuadVertex4Y, QuadVertex4Z));
+				cur_verts[std::make_tuple(QuadVertex4X, QuadVertex4Y, QuadVertex4Z)] = i4;
+			}
 
-				imp->inds.push_back(i4);
-				imp->inds.push_back(i3);
-				imp->inds.push_back(i2);
+			tile.inds.push_back(i4);
+			tile.inds.push_back(i3);
+			tile.inds.push_back(i2);
 
-				imp->inds.push_back(i2);
-				imp->inds.push_back(i1);
-				imp->inds.push_back(i4);
-			}
+			tile.inds.push_back(i2);
+			tile.inds.push_back(i1);
+			tile.inds.push_back(i4);
 		}
 	}
+}
 
-	float t;
-	for(auto &v : imp->verts) {
-		t = v.y;
-		v.y = v.z;
-		v.z = t;
+//expands a batch of tiles across the pool, then uses their sizes to work out where each lands in the
+//output so they can be copied into disjoint ranges of it without locking
+static void AppendTerrainTiles(std::vector<TerrainTileEntry> &tiles, size_t count, uint32_t quads_per_tile, float units_per_vertex,
+	std::vector<glm::vec3> &verts, std::vector<unsigned int> &inds) {
+	auto &pool = EQEmu::ThreadPool::Instance();
+	pool.ParallelFor(count, [&](size_t i) {
+		ExpandTerrainTile(tiles[i], quads_per_tile, units_per_vertex);
+	});
+
+	std::vector<size_t> vert_offsets(count + 1);
+	std::vector<size_t> ind_offsets(count + 1);
+	vert_offsets[0] = verts.size();
+	ind_offsets[0] = inds.size();
+	for (size_t i = 0; i < count; ++i) {
+		vert_offsets[i + 1] = vert_offsets[i] + tiles[i].verts.size();
+		ind_offsets[i + 1] = ind_offsets[i] + tiles[i].inds.size();
 	}
 
-	for(auto &vert : imp->verts) {
-		if(vert.x < imp->min.x) {
-			imp->min.x = vert.x;
-		}
+	verts.resize(vert_offsets[count]);
+	inds.resize(ind_offsets[count]);
+	pool.ParallelFor(count, [&](size_t i) {
+		auto &tile = tiles[i];
+		std::copy(tile.verts.begin(), tile.verts.end(), verts.begin() + vert_offsets[i]);
 
-		if(vert.y < imp->min.y && vert.y > -15000) {
-			imp->min.y = vert.y;
+		unsigned int base = (unsigned int)vert_offsets[i];
+		unsigned int *out = &inds[ind_offsets[i]];
+		for (size_t j = 0; j < tile.inds.size(); ++j) {
+			out[j] = base + tile.inds[j];
 		}
+	});
+}
 
-		if(vert.z < imp->min.z) {
-			imp->min.z = vert.z;
+//v2 maps are stored y/z swapped, swaps them back and grows the bounds to fit. Chunks are bounded
+//in parallel and merged in order, min and max are exact so the result matches a single pass
+static void SwapAxesAndBound(std::vector<glm::vec3> &verts, glm::vec3 &min, glm::vec3 &max, bool ignore_underworld) {
+	size_t chunks = (verts.size() + MAP_V2_BOUNDS_CHUNK - 1) / MAP_V2_BOUNDS_CHUNK;
+	std::vector<glm::vec3> mins(chunks, min);
+	std::vector<glm::vec3> maxs(chunks, max);
+	EQEmu::ThreadPool::Instance().ParallelFor(chunks, [&](size_t c) {
+		size_t end = std::min(verts.size(), (c + 1) * MAP_V2_BOUNDS_CHUNK);
+		for (size_t i = c * MAP_V2_BOUNDS_CHUNK; i < end; ++i) {
+			auto &v = verts[i];
+			std::swap(v.y, v.z);
+			ExtendBounds(v, mins[c], maxs[c], ignore_underworld);
 		}
+	});
 
-		if(vert.x > imp->max.x) {
-			imp->max.x = vert.x;
-		}
+	for (size_t c = 0; c < chunks; ++c) {
+		ExtendBounds(mins[c], min, max, ignore_underworld);
+		ExtendBounds(maxs[c], min, max, ignore_underworld);
+	}
+}
 
-		if(vert.y > imp->max.y) {
-			imp->max.y = vert.y;
+static void BoundInstances(EQEmu::Span<const EQEmu::InstancedModel> models, EQEmu::Span<const EQEmu::MeshInstance> instances,
+	glm::vec3 &min, glm::vec3 &max, bool ignore_underworld) {
+	auto &pool = EQEmu::ThreadPool::Instance();
+	size_t partitions = std::min(instances.size(), pool.Size() * 4);
+	std::vector<glm::vec3> mins(partitions, min);
+	std::vector<glm::vec3> maxs(partitions, max);
+	pool.ParallelFor(partitions, [&](size_t p) {
+		std::vector<glm::vec3> scratch;
+		for (size_t i = p; i < instances.size(); i += partitions) {
+			auto &model = models[instances[i].model];
+			scratch.resize(model.verts.size());
+			EQEmu::TransformVertices(instances[i].transform, model.verts.data(), scratch.data(), scratch.size());
+			for (auto &vert : scratch) {
+				ExtendBounds(vert, mins[p], maxs[p], ignore_underworld);
+			}
 		}
+	});
 
-		if(vert.z > imp->max.z) {
-			imp->max.z = vert.z;
-		}
+	for (size_t p = 0; p < partitions; ++p) {
+		ExtendBounds(mins[p], min, max, ignore_underworld);
+		ExtendBounds(maxs[p], min, max, ignore_underworld);
 	}
+}
 
-	for(auto &v : imp->nc_verts) {
-		t = v.y;
-		v.y = v.z;
-		v.z = t;
+//appends every instance as plain triangles. A prefix sum over the instance sizes gives each one its
+//own range of the output, so they're filled in parallel with a single resize up front
+static void ExpandInstances(EQEmu::Span<const EQEmu::InstancedModel> models, EQEmu::Span<const EQEmu::MeshInstance> instances,
+	std::vector<glm::vec3> &verts, std::vector<unsigned int> &inds) {
+	std::vector<size_t> vert_offsets(instances.size() + 1);
+	std::vector<size_t> ind_offsets(instances.size() + 1);
+	vert_offsets[0] = verts.size();
+	ind_offsets[0] = inds.size();
+	for (size_t i = 0; i < instances.size(); ++i) {
+		auto &model = models[instances[i].model];
+		bool empty = model.inds.empty();
+		vert_offsets[i + 1] = vert_offsets[i] + (empty ? 0 : model.verts.size());
+		ind_offsets[i + 1] = ind_offsets[i] + model.inds.size();
 	}
 
-	for(auto &vert : imp->nc_verts) {
-		if(vert.x < imp->nc_min.x) {
-			imp->nc_min.x = vert.x;
+	verts.resize(vert_offsets[instances.size()]);
+	inds.resize(ind_offsets[instances.size()]);
+	EQEmu::ThreadPool::Instance().ParallelFor(instances.size(), [&](size_t i) {
+		auto &model = models[instances[i].model];
+		if (model.inds.empty()) {
+			return;
 		}
 
-		if(vert.y < imp->nc_min.y) {
-			imp->nc_min.y = vert.y;
+		EQEmu::TransformVertices(instances[i].transform, model.verts.data(), &verts[vert_offsets[i]], model.verts.size());
+
+		unsigned int base = (unsigned int)vert_offsets[i];
+		unsigned int *out = &inds[ind_offsets[i]];
+		for (size_t j = 0; j < model.inds.size(); ++j) {
+			out[j] = base + model.inds[j];
+		}
+	});
+}
+
+//a chunk as it is built for writing, both halves with their own copy of the verts they use
+struct ChunkBuild
+{
+	std::vector<glm::vec3> verts;
+	std::vector<unsigned int> inds;
+	std::vector<glm::vec3> nc_verts;
+	std::vector<unsigned int> nc_inds;
+	std::vector<char> compressed;
+};
+
+static int32_t ChunkCoord(float v, float chunk_size) {
+	float c = floorf(v / chunk_size);
+	if (!(c > -2147483648.0f)) {
+		return INT32_MIN;
+	}
+
+	if (c >= 2147483647.0f) {
+		return INT32_MAX;
+	}
+
+	return (int32_t)c;
+}
+
+//buckets triangles into grid cells by their centre on x/z, then copies each cell's triangles out
+//with only the verts they reference
+static void PartitionMesh(EQEmu::Span<const glm::vec3> verts, EQEmu::Span<const unsigned int> inds, float chunk_size, bool collidable,
+	std::map<std::pair<int32_t, int32_t>, ChunkBuild> &chunks) {
+	std::map<std::pair<int32_t, int32_t>, std::vector<uint32_t>> cells;
+	for (size_t i = 0; i + 2 < inds.size(); i += 3) {
+		glm::vec3 center = (verts[inds[i]] + verts[inds[i + 1]] + verts[inds[i + 2]]) / 3.0f;
+		cells[std::make_pair(ChunkCoord(center.x, chunk_size), ChunkCoord(center.z, chunk_size))].push_back((uint32_t)i);
+	}
+
+	const uint32_t none = 0xFFFFFFFFu;
+	std::vector<uint32_t> remap(verts.size(), none);
+	std::vector<uint32_t> touched;
+	for (auto &cell : cells) {
+		auto &chunk = chunks[cell.first];
+		auto &out_verts = collidable ? chunk.verts : chunk.nc_verts;
+		auto &out_inds = collidable ? chunk.inds : chunk.nc_inds;
+		for (auto tri : cell.second) {
+			for (uint32_t j = 0; j < 3; ++j) {
+				uint32_t v = inds[tri + j];
+				if (remap[v] == none) {
+					remap[v] = (uint32_t)out_verts.size();
+					out_verts.push_back(verts[v]);
+					touched.push_back(v);
+				}
+
+				out_inds.push_back(remap[v]);
+			}
+		}
+
+		for (auto v : touched) {
+			remap[v] = none;
+		}
+		touched.clear();
+	}
+}
+
+//removes a resident chunk's range from a vert/ind list, everything after it moves down
+static void RemoveChunkRange(std::vector<glm::vec3> &verts, std::vector<unsigned int> &inds, size_t vert_start, size_t vert_count,
+	size_t ind_start, size_t ind_count) {
+	verts.erase(verts.begin() + vert_start, verts.begin() + vert_start + vert_count);
+	inds.erase(inds.begin() + ind_start, inds.begin() + ind_start + ind_count);
+	for (size_t i = ind_start; i < inds.size(); ++i) {
+		inds[i] -= (unsigned int)vert_count;
+	}
+}
+
+static bool BoxesOverlap(const glm::vec3 &a_min, const glm::vec3 &a_max, const glm::vec3 &b_min, const glm::vec3 &b_max) {
+	return a_min.x <= b_max.x && a_max.x >= b_min.x &&
+		a_min.y <= b_max.y && a_max.y >= b_min.y &&
+		a_min.z <= b_max.z && a_max.z >= b_min.z;
+}
+
+bool ZoneMap::LoadV2(FILE *f) {
+	uint32_t data_size;
+	if (fread(&data_size, sizeof(data_size), 1, f) != 1) {
+		return false;
+	}
+
+	uint32_t buffer_size;
+	if (fread(&buffer_size, sizeof(buffer_size), 1, f) != 1) {
+		return false;
+	}
+
+	PayloadReader reader(f, data_size, buffer_size);
+	return LoadV2Geometry(reader);
+}
+
+bool ZoneMap::LoadV2Chunked(FILE *f) {
+	MapV2ChunkedHeader header;
+	if (fread(&header, sizeof(header), 1, f) != 1) {
+		return false;
+	}
+
+	long start = ftell(f);
+	if (start < 0 || fseek(f, 0, SEEK_END) != 0) {
+		return false;
+	}
+
+	uint64_t file_left = (uint64_t)ftell(f) - (uint64_t)start;
+	if (fseek(f, start, SEEK_SET) != 0 || (uint64_t)header.chunk_count * sizeof(MapV2PayloadChunk) > file_left) {
+		return false;
+	}
+
+	std::vector<MapV2PayloadChunk> table(header.chunk_count);
+	if (header.chunk_count > 0 && fread(&table[0], sizeof(MapV2PayloadChunk), header.chunk_count, f) != header.chunk_count) {
+		return false;
+	}
+
+	//the table has to describe exactly the payload and the data that follows it
+	uint64_t compressed = (uint64_t)header.chunk_count * sizeof(MapV2PayloadChunk);
+	uint64_t uncompressed = 0;
+	for (auto &c : table) {
+		compressed += c.compressed_size;
+		uncompressed += c.uncompressed_size;
+	}
+
+	if (compressed > file_left || uncompressed != header.payload_size) {
+		return false;
+	}
+
+	PayloadReader reader(f, table, header.payload_size);
+	return LoadV2Geometry(reader);
+}
+
+bool ZoneMap::LoadV2Payload(const char *data, size_t size) {
+	PayloadReader reader(data, size);
+	return LoadV2Geometry(reader);
+}
+
+bool ZoneMap::LoadV2Geometry(PayloadReader &reader) {
+	uint32_t vert_count;
+	uint32_t ind_count;
+	uint32_t nc_vert_count;
+	uint32_t nc_ind_count;
+	uint32_t model_count;
+	uint32_t plac_count;
+	uint32_t plac_group_count;
+	uint32_t tile_count;
+	uint32_t quads_per_tile;
+	float units_per_vertex;
+
+	if (!reader.ReadValue(vert_count) || !reader.ReadValue(ind_count) || !reader.ReadValue(nc_vert_count) ||
+		!reader.ReadValue(nc_ind_count) || !reader.ReadValue(model_count) || !reader.ReadValue(plac_count) ||
+		!reader.ReadValue(plac_group_count) || !reader.ReadValue(tile_count) || !reader.ReadValue(quads_per_tile) ||
+		!reader.ReadValue(units_per_vertex)) {
+		return false;
+	}
+
+	//sections come in file order, once nothing later is wanted the rest of the payload isn't inflated at all.
+	//terrain is all collidable so it goes with the collidable half
+	bool want_collidable = (imp->load_flags & MapLoadCollidable) != 0;
+	bool want_non_collidable = (imp->load_flags & MapLoadNonCollidable) != 0;
+	bool want_placeables = (imp->load_flags & MapLoadPlaceables) && (want_collidable || want_non_collidable);
+	bool want_terrain = (imp->load_flags & MapLoadTerrain) && want_collidable;
+	bool want_rest = want_placeables || want_terrain;
+	if (want_collidable) {
+		if (!reader.ReadArray(imp->verts, vert_count) || !reader.ReadArray(imp->inds, ind_count)) {
+			return false;
+		}
+
+		//same checks as v3, a bad index would otherwise reach the physics code
+		if (ind_count % 3 != 0) {
+			return false;
+		}
+
+		for (auto ind : imp->inds) {
+			if (ind >= vert_count) {
+				return false;
+			}
+		}
+	}
+	else if ((want_non_collidable || want_rest) &&
+		!reader.Skip((size_t)vert_count * sizeof(glm::vec3) + (size_t)ind_count * sizeof(unsigned int))) {
+		return false;
+	}
+
+	if (want_non_collidable) {
+		if (!reader.ReadArray(imp->nc_verts, nc_vert_count) || !reader.ReadArray(imp->nc_inds, nc_ind_count)) {
+			return false;
+		}
+
+		if (nc_ind_count % 3 != 0) {
+			return false;
+		}
+
+		for (auto ind : imp->nc_inds) {
+			if (ind >= nc_vert_count) {
+				return false;
+			}
+		}
+	}
+	else if (want_rest && !reader.Skip((size_t)nc_vert_count * sizeof(glm::vec3) + (size_t)nc_ind_count * sizeof(unsigned int))) {
+		return false;
+	}
+
+	if (want_rest) {
+		if (!LoadV2Placeables(reader, model_count, plac_count, plac_group_count, want_placeables)) {
+			return false;
+		}
+	}
+
+	if (want_terrain && !LoadV2Terrain(reader, tile_count, quads_per_tile, units_per_vertex)) {
+		return false;
+	}
+
+	SwapAxesAndBound(imp->verts, imp->min, imp->max, true);
+	SwapAxesAndBound(imp->nc_verts, imp->nc_min, imp->nc_max, false);
+
+	//instances count toward the bounds as if they had been expanded
+	BoundInstances(imp->models, imp->instances, imp->min, imp->max, true);
+	BoundInstances(imp->nc_models, imp->instances, imp->nc_min, imp->nc_max, false);
+
+	return true;
+}
+
+//with want_instances false the records are only read to get past them
+bool ZoneMap::LoadV2Placeables(PayloadReader &reader, uint32_t model_count, uint32_t plac_count, uint32_t plac_group_count, bool want_instances) {
+	//polys are packed as three indices and a vis byte
+	const size_t poly_size = sizeof(uint32_t) * 3 + sizeof(uint8_t);
+	std::vector<char> raw_polys;
+	std::map<std::string, std::shared_ptr<ModelEntry>> models;
+	for (uint32_t i = 0; i < model_count; ++i) {
+		std::string name;
+		uint32_t vert_count;
+		uint32_t poly_count;
+		if (!reader.ReadString(name) || !reader.ReadValue(vert_count) || !reader.ReadValue(poly_count)) {
+			return false;
+		}
+
+		if (!want_instances) {
+			if (!reader.Skip((size_t)vert_count * sizeof(glm::vec3) + (size_t)poly_count * poly_size)) {
+				return false;
+			}
+			continue;
+		}
+
+		std::shared_ptr<ModelEntry> me(new ModelEntry);
+		if (!reader.ReadArray(me->verts, vert_count) || (uint64_t)poly_count * poly_size > reader.Remaining()) {
+			return false;
+		}
+
+		raw_polys.resize(poly_count * poly_size);
+		if (poly_count > 0 && !reader.Read(&raw_polys[0], raw_polys.size())) {
+			return false;
+		}
+
+		me->polys.resize(poly_count);
+		for (uint32_t j = 0; j < poly_count; ++j) {
+			auto &p = me->polys[j];
+			const char *src = &raw_polys[j * poly_size];
+			memcpy(&p.v1, src, sizeof(uint32_t));
+			memcpy(&p.v2, src + 4, sizeof(uint32_t));
+			memcpy(&p.v3, src + 8, sizeof(uint32_t));
+			p.vis = (uint8_t)src[12];
+
+			if (p.v1 >= vert_count || p.v2 >= vert_count || p.v3 >= vert_count) {
+				return false;
+			}
+		}
+
+		models[name] = me;
+	}
+
+	//a placeable is at least its name terminator and nine floats, anything claiming more can't be real
+	const size_t min_placeable_size = 1 + sizeof(float) * 9;
+	if ((uint64_t)plac_count * min_placeable_size > reader.Remaining()) {
+		return false;
+	}
+
+	std::vector<PlaceableEntry> placeables(plac_count);
+	for (auto &pl : placeables) {
+		if (!reader.ReadString(pl.name) || !reader.Read(pl.values, sizeof(pl.values))) {
+			return false;
+		}
+	}
+
+	std::vector<PlaceableGroupEntry> groups;
+	for (uint32_t i = 0; i < plac_group_count; ++i) {
+		PlaceableGroupEntry group;
+		uint32_t p_count;
+		if (!reader.Read(group.values, sizeof(group.values)) || !reader.ReadValue(p_count) ||
+			(uint64_t)p_count * min_placeable_size > reader.Remaining()) {
+			return false;
+		}
+
+		group.placeables.resize(p_count);
+		for (auto &pl : group.placeables) {
+			if (!reader.ReadString(pl.name) || !reader.Read(pl.values, sizeof(pl.values))) {
+				return false;
+			}
+		}
+
+		groups.push_back(std::move(group));
+	}
+
+	//placeables keep a single copy of each model they use plus where it goes, nothing is expanded
+	std::map<std::string, uint32_t> model_index;
+	auto add_instance = [&](const std::string &name, const glm::mat4x3 &transform) {
+		auto model_iter = models.find(name);
+		if (model_iter == models.end()) {
+			return;
+		}
+
+		uint32_t idx;
+		auto idx_iter = model_index.find(name);
+		if (idx_iter == model_index.end()) {
+			idx = (uint32_t)imp->models.size();
+			imp->models.push_back(EQEmu::InstancedModel());
+			imp->nc_models.push_back(EQEmu::InstancedModel());
+			if (imp->load_flags & MapLoadCollidable) {
+				SplitModel(*model_iter->second, true, imp->models.back());
+			}
+
+			if (imp->load_flags & MapLoadNonCollidable) {
+				SplitModel(*model_iter->second, false, imp->nc_models.back());
+			}
+			model_index[name] = idx;
+		}
+		else {
+			idx = idx_iter->second;
+		}
+
+		EQEmu::MeshInstance instance;
+		instance.model = idx;
+		instance.transform = transform;
+		imp->instances.push_back(instance);
+	};
+
+	for (auto &pl : placeables) {
+		EQEmu::AffineTransform t;
+		t.Rotate(pl.values[3], pl.values[4], pl.values[5]);
+		t.Scale(pl.values[6], pl.values[7], pl.values[8]);
+		t.Translate(pl.values[0], pl.values[1], pl.values[2]);
+
+		//placeables are stored x/y swapped, then everything gets y/z swapped on the way out
+		t.SwapAxes(0, 1);
+		t.SwapAxes(1, 2);
+		add_instance(pl.name, t.GetMatrix());
+	}
+
+	for (auto &group : groups) {
+		float x = group.values[0];
+		float y = group.values[1];
+		float z = group.values[2];
+
+		float x_rot = group.values[3];
+		float y_rot = group.values[4];
+		float z_rot = group.values[5];
+
+		float x_scale = group.values[6];
+		float y_scale = group.values[7];
+		float z_scale = group.values[8];
+
+		float x_tile = group.values[9];
+		float y_tile = group.values[10];
+		float z_tile = group.values[11];
+
+		for (auto &pl : group.placeables) {
+			float p_x = pl.values[0];
+			float p_y = pl.values[1];
+			float p_z = pl.values[2];
+
+			float p_x_rot = pl.values[3] * 3.14159f / 180;
+			float p_y_rot = pl.values[4] * 3.14159f / 180;
+			float p_z_rot = pl.values[5] * 3.14159f / 180;
+
+			float p_x_scale = pl.values[6];
+			float p_y_scale = pl.values[7];
+			float p_z_scale = pl.values[8];
+
+			glm::vec3 correction(p_x, p_y, p_z);
+			EQEmu::RotateVertex(correction, x_rot * 3.14159f / 180.0f, 0, 0);
+
+			EQEmu::AffineTransform t;
+			t.Scale(p_x_scale, p_y_scale, p_z_scale);
+			t.Translate(p_x, p_y, p_z);
+			t.Rotate(x_rot * 3.14159f / 180.0f, 0, 0);
+			t.Rotate(0, y_rot * 3.14159f / 180.0f, 0);
+			t.Translate(-correction.x, -correction.y, -correction.z);
+			t.Rotate(p_x_rot, 0, 0);
+			t.Rotate(0, -p_y_rot, 0);
+			t.Rotate(0, 0, p_z_rot);
+			t.Translate(correction.x, correction.y, correction.z);
+			t.Rotate(0, 0, z_rot * 3.14159f / 180.0f);
+			t.Scale(x_scale, y_scale, z_scale);
+			t.Translate(x_tile, y_tile, z_tile);
+			t.Translate(x, y, z);
+			t.SwapAxes(0, 1);
+			t.SwapAxes(1, 2);
+			add_instance(pl.name, t.GetMatrix());
+		}
+	}
+
+	return true;
+}
+
+//terrain is read in batches that are expanded in parallel, only the current batch is kept around
+bool ZoneMap::LoadV2Terrain(PayloadReader &reader, uint32_t tile_count, uint32_t quads_per_tile, float units_per_vertex) {
+	if (quads_per_tile > 0xFFFF) {
+		return false;
+	}
+
+	uint32_t ter_quad_count = (quads_per_tile * quads_per_tile);
+	uint32_t ter_vert_count = ((quads_per_tile + 1) * (quads_per_tile + 1));
+	size_t tile_bytes = ter_quad_count + ter_vert_count * (sizeof(float) + sizeof(glm::vec3)) + ter_quad_count * 6 * sizeof(unsigned int);
+	size_t batch_size = std::max((size_t)1, std::min((size_t)tile_count, MAP_V2_TERRAIN_BATCH_BYTES / tile_bytes));
+	std::vector<TerrainTileEntry> tiles(batch_size);
+	size_t batched = 0;
+	for (uint32_t i = 0; i < tile_count; ++i) {
+		auto &tile = tiles[batched];
+		if (!reader.ReadValue(tile.flat) || !reader.ReadValue(tile.x) || !reader.ReadValue(tile.y)) {
+			return false;
+		}
+
+		if (tile.flat) {
+			if (!reader.ReadValue(tile.z)) {
+				return false;
+			}
+		}
+		else if (!reader.ReadArray(tile.flags, ter_quad_count) || !reader.ReadArray(tile.floats, ter_vert_count)) {
+			return false;
+		}
+
+		if (++batched == batch_size) {
+			AppendTerrainTiles(tiles, batched, quads_per_tile, units_per_vertex, imp->verts, imp->inds);
+			batched = 0;
+		}
+	}
+
+	AppendTerrainTiles(tiles, batched, quads_per_tile, units_per_vertex, imp->verts, imp->inds);
+	return true;
+}
+
+bool ZoneMap::LoadV3(const std::string &filename) {
+	std::unique_ptr<EQEmu::MemoryMappedFile> mapped(new EQEmu::MemoryMappedFile());
+	if (!mapped->Open(filename)) {
+		return false;
+	}
+
+	const char *data = mapped->Data();
+	size_t size = mapped->Size();
+	if (size < sizeof(MapV3Header)) {
+		return false;
+	}
+
+	MapV3Header header;
+	memcpy(&header, data, sizeof(header));
+	if (header.version != MAP_V3_VERSION || header.section_count > MAP_V3_MAX_SECTIONS ||
+		sizeof(MapV3Header) + (size_t)header.section_count * sizeof(MapV3Section) > size) {
+		return false;
+	}
+
+	EQEmu::Span<const glm::vec3> verts;
+	EQEmu::Span<const unsigned int> inds;
+	EQEmu::Span<const glm::vec3> nc_verts;
+	EQEmu::Span<const unsigned int> nc_inds;
+	for (uint32_t i = 0; i < header.section_count; ++i) {
+		MapV3Section section;
+		memcpy(&section, data + sizeof(MapV3Header) + i * sizeof(MapV3Section), sizeof(section));
+
+		if (section.offset % MAP_V3_ALIGNMENT != 0 || section.offset > size || section.element_size == 0 ||
+			section.count > (size - section.offset) / section.element_size) {
+			return false;
+		}
+
+		const char *start = data + section.offset;
+		switch (section.type) {
+		case MapV3CollideVerts:
+			if (section.element_size != sizeof(glm::vec3)) {
+				return false;
+			}
+			verts = EQEmu::Span<const glm::vec3>((const glm::vec3*)start, (size_t)section.count);
+			break;
+		case MapV3CollideInds:
+			if (section.element_size != sizeof(unsigned int)) {
+				return false;
+			}
+			inds = EQEmu::Span<const unsigned int>((const unsigned int*)start, (size_t)section.count);
+			break;
+		case MapV3NonCollideVerts:
+			if (section.element_size != sizeof(glm::vec3)) {
+				return false;
+			}
+			nc_verts = EQEmu::Span<const glm::vec3>((const glm::vec3*)start, (size_t)section.count);
+			break;
+		case MapV3NonCollideInds:
+			if (section.element_size != sizeof(unsigned int)) {
+				return false;
+			}
+			nc_inds = EQEmu::Span<const unsigned int>((const unsigned int*)start, (size_t)section.count);
+			break;
+		default:
+			//sections we don't know about are left for whoever does
+			break;
+		}
+	}
+
+	//v3 is already expanded so terrain and placeables can't be told apart, only the two halves are optional
+	if (!(imp->load_flags & MapLoadCollidable)) {
+		verts = EQEmu::Span<const glm::vec3>();
+		inds = EQEmu::Span<const unsigned int>();
+	}
+
+	if (!(imp->load_flags & MapLoadNonCollidable)) {
+		nc_verts = EQEmu::Span<const glm::vec3>();
+		nc_inds = EQEmu::Span<const unsigned int>();
+	}
+
+	//indices are the one thing that can take down the physics code so they're checked up front
+	if (inds.size() % 3 != 0 || nc_inds.size() % 3 != 0) {
+		return false;
+	}
+
+	for (auto ind : inds) {
+		if (ind >= verts.size()) {
+			return false;
+		}
+	}
+
+	for (auto ind : nc_inds) {
+		if (ind >= nc_verts.size()) {
+			return false;
+		}
+	}
+
+	if (imp->load_flags & MapLoadCollidable) {
+		imp->min = glm::vec3(header.min[0], header.min[1], header.min[2]);
+		imp->max = glm::vec3(header.max[0], header.max[1], header.max[2]);
+	}
+
+	if (imp->load_flags & MapLoadNonCollidable) {
+		imp->nc_min = glm::vec3(header.nc_min[0], header.nc_min[1], header.nc_min[2]);
+		imp->nc_max = glm::vec3(header.nc_max[0], header.nc_max[1], header.nc_max[2]);
+	}
+	imp->mapped_verts = verts;
+	imp->mapped_inds = inds;
+	imp->mapped_nc_verts = nc_verts;
+	imp->mapped_nc_inds = nc_inds;
+	imp->mapped = std::move(mapped);
+	return true;
+}
+
+bool ZoneMap::LoadV4(FILE *f, const std::string &filename) {
+	MapV4Header header;
+	if (fseek(f, 0, SEEK_END) != 0) {
+		return false;
+	}
+
+	uint64_t file_size = (uint64_t)ftell(f);
+	if (fseek(f, 0, SEEK_SET) != 0 || fread(&header, sizeof(header), 1, f) != 1 || header.version != MAP_V4_VERSION) {
+		return false;
+	}
+
+	uint64_t table_end = sizeof(MapV4Header) + (uint64_t)header.chunk_count * sizeof(MapV4Chunk);
+	if (table_end > file_size) {
+		return false;
+	}
+
+	std::vector<MapV4Chunk> records(header.chunk_count);
+	if (header.chunk_count > 0 && fread(&records[0], sizeof(MapV4Chunk), header.chunk_count, f) != header.chunk_count) {
+		return false;
+	}
+
+	//every chunk has to fit in the file and inflate to something a uint32_t can describe
+	for (auto &record : records) {
+		uint64_t raw_size = ((uint64_t)record.vert_count + record.nc_vert_count) * sizeof(glm::vec3) +
+			((uint64_t)record.ind_count + record.nc_ind_count) * sizeof(unsigned int);
+		if (record.offset < table_end || record.offset > file_size || record.compressed_size > file_size - record.offset ||
+			raw_size > 0xFFFFFFFFu || record.ind_count % 3 != 0 || record.nc_ind_count % 3 != 0) {
+			return false;
+		}
+	}
+
+	imp->chunk_file = filename;
+	imp->chunk_records.swap(records);
+	imp->chunks.resize(imp->chunk_records.size());
+	for (size_t i = 0; i < imp->chunks.size(); ++i) {
+		auto &record = imp->chunk_records[i];
+		auto &chunk = imp->chunks[i];
+		chunk = Chunk();
+		chunk.grid_x = record.grid_x;
+		chunk.grid_y = record.grid_y;
+		chunk.min = glm::vec3(record.min[0], record.min[1], record.min[2]);
+		chunk.max = glm::vec3(record.max[0], record.max[1], record.max[2]);
+	}
+
+	if (imp->load_flags & MapLoadCollidable) {
+		imp->min = glm::vec3(header.min[0], header.min[1], header.min[2]);
+		imp->max = glm::vec3(header.max[0], header.max[1], header.max[2]);
+	}
+
+	if (imp->load_flags & MapLoadNonCollidable) {
+		imp->nc_min = glm::vec3(header.nc_min[0], header.nc_min[1], header.nc_min[2]);
+		imp->nc_max = glm::vec3(header.nc_max[0], header.nc_max[1], header.nc_max[2]);
+	}
+
+	if (imp->load_flags & MapLoadChunksOnDemand) {
+		return true;
+	}
+
+	for (size_t i = 0; i < imp->chunks.size(); ++i) {
+		if (!LoadChunk(i)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ZoneMap::Weld(float epsilon) {
+	//chunks are welded as they come in, anything already resident is reloaded to pick that up
+	if (!imp->chunks.empty()) {
+		imp->weld_epsilon = epsilon;
+		std::vector<size_t> resident;
+		for (size_t i = 0; i < imp->chunks.size(); ++i) {
+			if (imp->chunks[i].resident) {
+				resident.push_back(i);
+				UnloadChunk(i);
+			}
+		}
+
+		for (auto idx : resident) {
+			LoadChunk(idx);
+		}
+		return;
+	}
+
+	//welding rewrites the buffers so a mapped v3 file gets copied out first
+	if (imp->mapped) {
+		imp->verts.assign(imp->mapped_verts.begin(), imp->mapped_verts.end());
+		imp->inds.assign(imp->mapped_inds.begin(), imp->mapped_inds.end());
+		imp->nc_verts.assign(imp->mapped_nc_verts.begin(), imp->mapped_nc_verts.end());
+		imp->nc_inds.assign(imp->mapped_nc_inds.begin(), imp->mapped_nc_inds.end());
+		imp->mapped_verts = EQEmu::Span<const glm::vec3>();
+		imp->mapped_inds = EQEmu::Span<const unsigned int>();
+		imp->mapped_nc_verts = EQEmu::Span<const glm::vec3>();
+		imp->mapped_nc_inds = EQEmu::Span<const unsigned int>();
+		imp->mapped.reset();
+	}
+
+	WeldVertices(imp->verts, imp->inds, epsilon);
+	WeldVertices(imp->nc_verts, imp->nc_inds, epsilon);
+	for (auto &model : imp->models) {
+		WeldVertices(model.verts, model.inds, epsilon);
+	}
+
+	for (auto &model : imp->nc_models) {
+		WeldVertices(model.verts, model.inds, epsilon);
+	}
+}
+
+void ZoneMap::Flatten() {
+	if (imp->instances.empty()) {
+		return;
+	}
+
+	ExpandInstances(imp->models, imp->instances, imp->verts, imp->inds);
+	ExpandInstances(imp->nc_models, imp->instances, imp->nc_verts, imp->nc_inds);
+
+	std::vector<EQEmu::InstancedModel>().swap(imp->models);
+	std::vector<EQEmu::InstancedModel>().swap(imp->nc_models);
+	std::vector<EQEmu::MeshInstance>().swap(imp->instances);
+}
+
+//v3 and v4 are always flat, any instances are expanded into a scratch copy for writing
+void ZoneMap::GetFlatGeometry(FlatGeometry &out) const {
+	out.verts = GetCollidableVerts();
+	out.inds = GetCollidableInds();
+	out.nc_verts = GetNonCollidableVerts();
+	out.nc_inds = GetNonCollidableInds();
+	if (imp->instances.empty()) {
+		return;
+	}
+
+	out.flat_verts.assign(out.verts.begin(), out.verts.end());
+	out.flat_inds.assign(out.inds.begin(), out.inds.end());
+	out.flat_nc_verts.assign(out.nc_verts.begin(), out.nc_verts.end());
+	out.flat_nc_inds.assign(out.nc_inds.begin(), out.nc_inds.end());
+	ExpandInstances(imp->models, imp->instances, out.flat_verts, out.flat_inds);
+	ExpandInstances(imp->nc_models, imp->instances, out.flat_nc_verts, out.flat_nc_inds);
+	out.verts = out.flat_verts;
+	out.inds = out.flat_inds;
+	out.nc_verts = out.flat_nc_verts;
+	out.nc_inds = out.flat_nc_inds;
+}
+
+bool ZoneMap::WriteV3(std::string filename) const {
+	FlatGeometry flat;
+	GetFlatGeometry(flat);
+	auto &verts = flat.verts;
+	auto &inds = flat.inds;
+	auto &nc_verts = flat.nc_verts;
+	auto &nc_inds = flat.nc_inds;
+
+	struct Pending
+	{
+		uint32_t type;
+		uint32_t element_size;
+		const void *data;
+		uint64_t count;
+	};
+
+	Pending pending[] = {
+		{ MapV3CollideVerts, sizeof(glm::vec3), verts.data(), verts.size() },
+		{ MapV3CollideInds, sizeof(unsigned int), inds.data(), inds.size() },
+		{ MapV3NonCollideVerts, sizeof(glm::vec3), nc_verts.data(), nc_verts.size() },
+		{ MapV3NonCollideInds, sizeof(unsigned int), nc_inds.data(), nc_inds.size() },
+	};
+	const uint32_t section_count = sizeof(pending) / sizeof(Pending);
+
+	MapV3Header header;
+	memset(&header, 0, sizeof(header));
+	header.version = MAP_V3_VERSION;
+	header.section_count = section_count;
+	memcpy(header.min, &imp->min, sizeof(header.min));
+	memcpy(header.max, &imp->max, sizeof(header.max));
+	memcpy(header.nc_min, &imp->nc_min, sizeof(header.nc_min));
+	memcpy(header.nc_max, &imp->nc_max, sizeof(header.nc_max));
+
+	std::vector<MapV3Section> sections(section_count);
+	uint64_t offset = sizeof(MapV3Header) + section_count * sizeof(MapV3Section);
+	for (uint32_t i = 0; i < section_count; ++i) {
+		offset = (offset + MAP_V3_ALIGNMENT - 1) & ~(uint64_t)(MAP_V3_ALIGNMENT - 1);
+		sections[i].type = pending[i].type;
+		sections[i].element_size = pending[i].element_size;
+		sections[i].offset = offset;
+		sections[i].count = pending[i].count;
+		offset += pending[i].count * pending[i].element_size;
+	}
+
+	FILE *f = fopen(filename.c_str(), "wb");
+	if (!f) {
+		return false;
+	}
+
+	if (fwrite(&header, sizeof(header), 1, f) != 1 ||
+		fwrite(&sections[0], sizeof(MapV3Section), section_count, f) != section_count) {
+		fclose(f);
+		return false;
+	}
+
+	uint64_t position = sizeof(MapV3Header) + section_count * sizeof(MapV3Section);
+	const char padding[MAP_V3_ALIGNMENT] = { 0 };
+	for (uint32_t i = 0; i < section_count; ++i) {
+		size_t pad = (size_t)(sections[i].offset - position);
+		if (pad > 0 && fwrite(padding, pad, 1, f) != 1) {
+			fclose(f);
+			return false;
 		}
 
-		if(vert.z < imp->nc_min.z) {
-			imp->nc_min.z = vert.z;
+		size_t len = (size_t)(pending[i].count * pending[i].element_size);
+		if (len > 0 && fwrite(pending[i].data, len, 1, f) != 1) {
+			fclose(f);
+			return false;
 		}
 
-		if(vert.x > imp->nc_max.x) {
-			imp->nc_max.x = vert.x;
+		position = sections[i].offset + len;
+	}
+
+	fclose(f);
+	return true;
+}
+
+bool ZoneMap::WriteV4(std::string filename, float chunk_size, const EQEmu::CompressionOptions &opts) const {
+	if (!(chunk_size > 0.0f)) {
+		return false;
+	}
+
+	FlatGeometry flat;
+	GetFlatGeometry(flat);
+
+	std::map<std::pair<int32_t, int32_t>, ChunkBuild> builds;
+	PartitionMesh(flat.verts, flat.inds, chunk_size, true, builds);
+	PartitionMesh(flat.nc_verts, flat.nc_inds, chunk_size, false, builds);
+
+	std::vector<std::pair<const std::pair<int32_t, int32_t>, ChunkBuild>*> order;
+	for (auto &build : builds) {
+		order.push_back(&build);
+	}
+
+	std::atomic<bool> compressed(true);
+	std::vector<MapV4Chunk> records(order.size());
+	EQEmu::ThreadPool::Instance().ParallelFor(order.size(), [&](size_t i) {
+		auto &build = order[i]->second;
+		auto &record = records[i];
+		memset(&record, 0, sizeof(record));
+		record.grid_x = order[i]->first.first;
+		record.grid_y = order[i]->first.second;
+		record.vert_count = (uint32_t)build.verts.size();
+		record.ind_count = (uint32_t)build.inds.size();
+		record.nc_vert_count = (uint32_t)build.nc_verts.size();
+		record.nc_ind_count = (uint32_t)build.nc_inds.size();
+
+		glm::vec3 min(FLT_MAX);
+		glm::vec3 max(-FLT_MAX);
+		for (auto &v : build.verts) {
+			min = glm::min(min, v);
+			max = glm::max(max, v);
 		}
 
-		if(vert.y > imp->nc_max.y) {
-			imp->nc_max.y = vert.y;
+		for (auto &v : build.nc_verts) {
+			min = glm::min(min, v);
+			max = glm::max(max, v);
 		}
 
-		if(vert.z > imp->nc_max.z) {
-			imp->nc_max.z = vert.z;
+		memcpy(record.min, &min, sizeof(record.min));
+		memcpy(record.max, &max, sizeof(record.max));
+
+		std::vector<char> raw;
+		raw.insert(raw.end(), (const char*)build.verts.data(), (const char*)(build.verts.data() + build.verts.size()));
+		raw.insert(raw.end(), (const char*)build.inds.data(), (const char*)(build.inds.data() + build.inds.size()));
+		raw.insert(raw.end(), (const char*)build.nc_verts.data(), (const char*)(build.nc_verts.data() + build.nc_verts.size()));
+		raw.insert(raw.end(), (const char*)build.nc_inds.data(), (const char*)(build.nc_inds.data() + build.nc_inds.size()));
+
+		build.compressed.resize(EQEmu::DeflateBound((uint32_t)raw.size(), opts));
+		uint32_t size = EQEmu::DeflateData(raw.data(), (uint32_t)raw.size(), &build.compressed[0], (uint32_t)build.compressed.size(), opts);
+		if (size == 0) {
+			compressed = false;
 		}
+
+		build.compressed.resize(size);
+		record.compressed_size = size;
+	});
+
+	if (!compressed) {
+		return false;
+	}
+
+	MapV4Header header;
+	memset(&header, 0, sizeof(header));
+	header.version = MAP_V4_VERSION;
+	header.chunk_count = (uint32_t)records.size();
+	header.chunk_size = chunk_size;
+	memcpy(header.min, &imp->min, sizeof(header.min));
+	memcpy(header.max, &imp->max, sizeof(header.max));
+	memcpy(header.nc_min, &imp->nc_min, sizeof(header.nc_min));
+	memcpy(header.nc_max, &imp->nc_max, sizeof(header.nc_max));
+
+	uint64_t offset = sizeof(MapV4Header) + records.size() * sizeof(MapV4Chunk);
+	for (auto &record : records) {
+		record.offset = offset;
+		offset += record.compressed_size;
 	}
 
+	FILE *f = fopen(filename.c_str(), "wb");
+	if (!f) {
+		return false;
+	}
+
+	if (fwrite(&header, sizeof(header), 1, f) != 1 ||
+		(!records.empty() && fwrite(&records[0], sizeof(MapV4Chunk), records.size(), f) != records.size())) {
+		fclose(f);
+		return false;
+	}
+
+	for (auto build : order) {
+		auto &data = build->second.compressed;
+		if (!data.empty() && fwrite(&data[0], data.size(), 1, f) != 1) {
+			fclose(f);
+			return false;
+		}
+	}
+
+	fclose(f);
 	return true;
 }
 
-const std::vector<glm::vec3>& ZoneMap::GetCollidableVerts() const {
+EQEmu::Span<const glm::vec3> ZoneMap::GetCollidableVerts() const {
+	if (imp->mapped) {
+		return imp->mapped_verts;
+	}
+
 	return imp->verts;
 }
 
-const std::vector<unsigned int>& ZoneMap::GetCollidableInds() const {
+EQEmu::Span<const unsigned int> ZoneMap::GetCollidableInds() const {
+	if (imp->mapped) {
+		return imp->mapped_inds;
+	}
+
 	return imp->inds;
 }
 
@@ -847,11 +1910,19 @@ const glm::vec3& ZoneMap::GetCollidableMin() const {
 	return imp->min;
 }
 
-const std::vector<glm::vec3>& ZoneMap::GetNonCollidableVerts() const {
+EQEmu::Span<const glm::vec3> ZoneMap::GetNonCollidableVerts() const {
+	if (imp->mapped) {
+		return imp->mapped_nc_verts;
+	}
+
 	return imp->nc_verts;
 }
 
-const std::vector<unsigned int>& ZoneMap::GetNonCollidableInds() const {
+EQEmu::Span<const unsigned int> ZoneMap::GetNonCollidableInds() const {
+	if (imp->mapped) {
+		return imp->mapped_nc_inds;
+	}
+
 	return imp->nc_inds;
 }
 
@@ -863,33 +1934,172 @@ const glm::vec3& ZoneMap::GetNonCollidableMin() const {
 	return imp->nc_min;
 }
 
-void ZoneMap::RotateVertex(glm::vec3 &v, float rx, float ry, float rz) {
-	glm::vec3 nv = v;
+EQEmu::Span<const EQEmu::InstancedModel> ZoneMap::GetCollidableModels() const {
+	return imp->models;
+}
 
-	nv.y = (cos(rx) * v.y) - (sin(rx) * v.z);
-	nv.z = (sin(rx) * v.y) + (cos(rx) * v.z);
+EQEmu::Span<const EQEmu::InstancedModel> ZoneMap::GetNonCollidableModels() const {
+	return imp->nc_models;
+}
 
-	v = nv;
+EQEmu::Span<const EQEmu::MeshInstance> ZoneMap::GetInstances() const {
+	return imp->instances;
+}
 
-	nv.x = (cos(ry) * v.x) + (sin(ry) * v.z);
-	nv.z = -(sin(ry) * v.x) + (cos(ry) * v.z);
+uint32_t ZoneMap::GetLoadFlags() const {
+	return imp->load_flags;
+}
 
-	v = nv;
+EQEmu::Span<const ZoneMap::Chunk> ZoneMap::GetChunks() const {
+	return imp->chunks;
+}
 
-	nv.x = (cos(rz) * v.x) - (sin(rz) * v.y);
-	nv.y = (sin(rz) * v.x) + (cos(rz) * v.y);
+bool ZoneMap::LoadChunk(size_t idx) {
+	if (idx >= imp->chunks.size()) {
+		return false;
+	}
 
-	v = nv;
+	auto &chunk = imp->chunks[idx];
+	if (chunk.resident) {
+		return true;
+	}
+
+	auto &record = imp->chunk_records[idx];
+	size_t vert_bytes = (size_t)record.vert_count * sizeof(glm::vec3);
+	size_t ind_bytes = (size_t)record.ind_count * sizeof(unsigned int);
+	size_t nc_vert_bytes = (size_t)record.nc_vert_count * sizeof(glm::vec3);
+	size_t nc_ind_bytes = (size_t)record.nc_ind_count * sizeof(unsigned int);
+	size_t raw_size = vert_bytes + ind_bytes + nc_vert_bytes + nc_ind_bytes;
+
+	std::vector<char> raw(raw_size);
+	if (raw_size > 0) {
+		FILE *f = fopen(imp->chunk_file.c_str(), "rb");
+		if (!f) {
+			return false;
+		}
+
+		std::vector<char> compressed(record.compressed_size);
+		bool read = fseek(f, (long)record.offset, SEEK_SET) == 0 && !compressed.empty() &&
+			fread(&compressed[0], compressed.size(), 1, f) == 1;
+		fclose(f);
+
+		if (!read || EQEmu::InflateData(&compressed[0], record.compressed_size, &raw[0], (uint32_t)raw_size) != raw_size) {
+			return false;
+		}
+	}
+
+	std::vector<glm::vec3> verts(record.vert_count);
+	std::vector<unsigned int> inds(record.ind_count);
+	std::vector<glm::vec3> nc_verts(record.nc_vert_count);
+	std::vector<unsigned int> nc_inds(record.nc_ind_count);
+	const char *src = raw.data();
+	auto copy_out = [&src](void *dst, size_t len) {
+		if (len > 0) {
+			memcpy(dst, src, len);
+			src += len;
+		}
+	};
+
+	copy_out(verts.data(), vert_bytes);
+	copy_out(inds.data(), ind_bytes);
+	copy_out(nc_verts.data(), nc_vert_bytes);
+	copy_out(nc_inds.data(), nc_ind_bytes);
+
+	for (auto ind : inds) {
+		if (ind >= verts.size()) {
+			return false;
+		}
+	}
+
+	for (auto ind : nc_inds) {
+		if (ind >= nc_verts.size()) {
+			return false;
+		}
+	}
+
+	if (!(imp->load_flags & MapLoadCollidable)) {
+		verts.clear();
+		inds.clear();
+	}
+
+	if (!(imp->load_flags & MapLoadNonCollidable)) {
+		nc_verts.clear();
+		nc_inds.clear();
+	}
+
+	if (imp->weld_epsilon >= 0.0f) {
+		WeldVertices(verts, inds, imp->weld_epsilon);
+		WeldVertices(nc_verts, nc_inds, imp->weld_epsilon);
+	}
+
+	//chunks go on the end, so their inds only need shifting by whatever was resident before them
+	chunk.vert_start = imp->verts.size();
+	chunk.vert_count = verts.size();
+	chunk.ind_start = imp->inds.size();
+	chunk.ind_count = inds.size();
+	imp->verts.insert(imp->verts.end(), verts.begin(), verts.end());
+	for (auto ind : inds) {
+		imp->inds.push_back((unsigned int)chunk.vert_start + ind);
+	}
+
+	chunk.nc_vert_start = imp->nc_verts.size();
+	chunk.nc_vert_count = nc_verts.size();
+	chunk.nc_ind_start = imp->nc_inds.size();
+	chunk.nc_ind_count = nc_inds.size();
+	imp->nc_verts.insert(imp->nc_verts.end(), nc_verts.begin(), nc_verts.end());
+	for (auto ind : nc_inds) {
+		imp->nc_inds.push_back((unsigned int)chunk.nc_vert_start + ind);
+	}
+
+	chunk.resident = true;
+	return true;
 }
 
-void ZoneMap::ScaleVertex(glm::vec3 &v, float sx, float sy, float sz) {
-	v.x = v.x * sx;
-	v.y = v.y * sy;
-	v.z = v.z * sz;
+void ZoneMap::UnloadChunk(size_t idx) {
+	if (idx >= imp->chunks.size() || !imp->chunks[idx].resident) {
+		return;
+	}
+
+	auto &chunk = imp->chunks[idx];
+	RemoveChunkRange(imp->verts, imp->inds, chunk.vert_start, chunk.vert_count, chunk.ind_start, chunk.ind_count);
+	RemoveChunkRange(imp->nc_verts, imp->nc_inds, chunk.nc_vert_start, chunk.nc_vert_count, chunk.nc_ind_start, chunk.nc_ind_count);
+
+	for (auto &other : imp->chunks) {
+		if (!other.resident || &other == &chunk) {
+			continue;
+		}
+
+		if (other.vert_start > chunk.vert_start) {
+			other.vert_start -= chunk.vert_count;
+			other.ind_start -= chunk.ind_count;
+		}
+
+		if (other.nc_vert_start > chunk.nc_vert_start) {
+			other.nc_vert_start -= chunk.nc_vert_count;
+			other.nc_ind_start -= chunk.nc_ind_count;
+		}
+	}
+
+	chunk.resident = false;
+	chunk.vert_start = chunk.vert_count = chunk.ind_start = chunk.ind_count = 0;
+	chunk.nc_vert_start = chunk.nc_vert_count = chunk.nc_ind_start = chunk.nc_ind_count = 0;
+}
+
+bool ZoneMap::LoadChunks(const glm::vec3 &min, const glm::vec3 &max) {
+	bool success = true;
+	for (size_t i = 0; i < imp->chunks.size(); ++i) {
+		if (BoxesOverlap(imp->chunks[i].min, imp->chunks[i].max, min, max) && !LoadChunk(i)) {
+			success = false;
+		}
+	}
+
+	return success;
 }
 
-void ZoneMap::TranslateVertex(glm::vec3 &v, float tx, float ty, float tz) {
-	v.x = v.x + tx;
-	v.y = v.y + ty;
-	v.z = v.z + tz;
+void ZoneMap::UnloadChunksOutside(const glm::vec3 &min, const glm::vec3 &max) {
+	for (size_t i = 0; i < imp->chunks.size(); ++i) {
+		if (!BoxesOverlap(imp->chunks[i].min, imp->chunks[i].max, min, max)) {
+			UnloadChunk(i);
+		}
+	}
 }
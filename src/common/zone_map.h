@@ -4,6 +4,21 @@
 #include <vector>
 
 #include "eq_physics.h"
+#include "mesh_instance.h"
+#include "span.h"
+#include "compression.h"
+
+//which parts of a map to load, anything left out is skipped instead of decoded
+enum ZoneMapLoadFlags
+{
+	MapLoadCollidable = 1,
+	MapLoadNonCollidable = 2,
+	MapLoadTerrain = 4,
+	MapLoadPlaceables = 8,
+	MapLoadAll = MapLoadCollidable | MapLoadNonCollidable | MapLoadTerrain | MapLoadPlaceables,
+	//v4 maps only read their chunk table, chunks are then loaded with LoadChunk/LoadChunks
+	MapLoadChunksOnDemand = 16
+};
 
 class ZoneMap
 {
@@ -11,25 +26,77 @@ public:
 	ZoneMap();
 	~ZoneMap();
 
-	bool Load(std::string filename);
-	static ZoneMap *LoadMapFile(std::string file);
-	
-	const std::vector<glm::vec3>& GetCollidableVerts() const;
-	const std::vector<unsigned int>& GetCollidableInds() const;
+	bool Load(std::string filename, uint32_t flags = MapLoadAll);
+	static ZoneMap *LoadMapFile(std::string file, uint32_t flags = MapLoadAll);
+	//what Load was asked for, everything else is left empty
+	uint32_t GetLoadFlags() const;
+
+	//takes the inflated body of a v2 map, used by azone to bake v3 files
+	bool LoadV2Payload(const char *buf, size_t size);
+	//writes whatever is loaded as a v3 map
+	bool WriteV3(std::string filename) const;
+	//writes whatever is loaded as a v4 map, triangles split into a grid of chunk_size cells across x/z
+	bool WriteV4(std::string filename, float chunk_size, const EQEmu::CompressionOptions &opts) const;
+
+	EQEmu::Span<const glm::vec3> GetCollidableVerts() const;
+	EQEmu::Span<const unsigned int> GetCollidableInds() const;
 	const glm::vec3& GetCollidableMax() const;
 	const glm::vec3& GetCollidableMin() const;
 
-	const std::vector<glm::vec3>& GetNonCollidableVerts() const;
-	const std::vector<unsigned int>& GetNonCollidableInds() const;
+	EQEmu::Span<const glm::vec3> GetNonCollidableVerts() const;
+	EQEmu::Span<const unsigned int> GetNonCollidableInds() const;
 	const glm::vec3& GetNonCollidableMax() const;
 	const glm::vec3& GetNonCollidableMin() const;
+
+	//v2 placeables are kept as instances and are not part of the vert/ind lists above,
+	//Flatten expands them in for anything that wants plain triangles
+	EQEmu::Span<const EQEmu::InstancedModel> GetCollidableModels() const;
+	EQEmu::Span<const EQEmu::InstancedModel> GetNonCollidableModels() const;
+	EQEmu::Span<const EQEmu::MeshInstance> GetInstances() const;
+	void Flatten();
+	//merges verts closer than epsilon into shared indices, 0 only merges exact duplicates
+	void Weld(float epsilon);
+
+	//v4 maps are a grid of chunks that can be loaded and dropped as needed. A resident chunk's
+	//triangles are part of the vert/ind lists above at the ranges recorded here, its inds index
+	//the whole vert list. The ranges move as other chunks come and go
+	struct Chunk
+	{
+		int32_t grid_x;
+		int32_t grid_y;
+		glm::vec3 min;
+		glm::vec3 max;
+		bool resident;
+		size_t vert_start;
+		size_t vert_count;
+		size_t ind_start;
+		size_t ind_count;
+		size_t nc_vert_start;
+		size_t nc_vert_count;
+		size_t nc_ind_start;
+		size_t nc_ind_count;
+	};
+
+	EQEmu::Span<const Chunk> GetChunks() const;
+	bool LoadChunk(size_t idx);
+	void UnloadChunk(size_t idx);
+	//loads every chunk whose bounds overlap the box
+	bool LoadChunks(const glm::vec3 &min, const glm::vec3 &max);
+	//drops every resident chunk whose bounds don't overlap the box
+	void UnloadChunksOutside(const glm::vec3 &min, const glm::vec3 &max);
 private:
-	void RotateVertex(glm::vec3 &v, float rx, float ry, float rz);
-	void ScaleVertex(glm::vec3 &v, float sx, float sy, float sz);
-	void TranslateVertex(glm::vec3 &v, float tx, float ty, float tz);
 	bool LoadV1(FILE *f);
 	bool LoadV2(FILE *f);
-	
+	bool LoadV2Chunked(FILE *f);
+	class PayloadReader;
+	bool LoadV2Geometry(PayloadReader &reader);
+	bool LoadV2Placeables(PayloadReader &reader, uint32_t model_count, uint32_t plac_count, uint32_t plac_group_count, bool want_instances);
+	bool LoadV2Terrain(PayloadReader &reader, uint32_t tile_count, uint32_t quads_per_tile, float units_per_vertex);
+	bool LoadV3(const std::string &filename);
+	bool LoadV4(FILE *f, const std::string &filename);
+	struct FlatGeometry;
+	void GetFlatGeometry(FlatGeometry &out) const;
+
 	struct impl;
 	impl *imp;
 };
@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <zlib.h>
+#include "compression.h"
+
+//minimum time spent on each measurement, short payloads are repeated until we reach it
+#define MIN_BENCH_SECONDS 0.25
+
+struct Setting
+{
+	std::string name;
+	EQEmu::CompressionOptions opts;
+};
+
+struct Result
+{
+	uint64_t in_size;
+	uint64_t out_size;
+	double compress_seconds;
+	double decompress_seconds;
+};
+
+void PrintUsage() {
+	printf("Usage: compression_bench <file_names>...\n"
+	"Compresses the payload of each .map or .nav file (or the whole file for anything else)\n"
+	"with a range of settings and reports ratio and compress/decompress throughput.\n"
+	);
+}
+
+bool ReadFile(const std::string &filename, std::vector<char> &buffer) {
+	FILE *f = fopen(filename.c_str(), "rb");
+	if (!f) {
+		return false;
+	}
+
+	fseek(f, 0, SEEK_END);
+	size_t sz = ftell(f);
+	rewind(f);
+
+	buffer.resize(sz);
+	if (sz > 0 && fread(&buffer[0], 1, sz, f) != sz) {
+		fclose(f);
+		return false;
+	}
+
+	fclose(f);
+	return true;
+}
+
+bool InflatePayload(const std::vector<char> &file, size_t idx, std::vector<char> &payload) {
+	if (file.size() < idx + 8) {
+		return false;
+	}
+
+	uint32_t data_size = *(uint32_t*)&file[idx];
+	uint32_t buffer_size = *(uint32_t*)&file[idx + 4];
+	idx += 8;
+
+	if (file.size() - idx < data_size || buffer_size == 0) {
+		return false;
+	}
+
+	payload.resize(buffer_size);
+	return EQEmu::InflateData(&file[idx], data_size, &payload[0], buffer_size) == buffer_size;
+}
+
+//chunked v2 maps: chunk count, payload size, then a compressed/uncompressed size pair per chunk
+bool InflateChunkedPayload(const std::vector<char> &file, size_t idx, std::vector<char> &payload) {
+	if (file.size() < idx + 8) {
+		return false;
+	}
+
+	uint32_t chunk_count = *(uint32_t*)&file[idx];
+	uint32_t payload_size = *(uint32_t*)&file[idx + 4];
+	idx += 8;
+
+	if ((file.size() - idx) / 8 < chunk_count || payload_size == 0) {
+		return false;
+	}
+
+	size_t table = idx;
+	size_t in = idx + (size_t)chunk_count * 8;
+	size_t out = 0;
+	payload.resize(payload_size);
+	for (uint32_t i = 0; i < chunk_count; ++i) {
+		uint32_t compressed_size = *(uint32_t*)&file[table + i * 8];
+		uint32_t uncompressed_size = *(uint32_t*)&file[table + i * 8 + 4];
+		if (file.size() - in < compressed_size || payload_size - out < uncompressed_size ||
+			EQEmu::InflateData(&file[in], compressed_size, &payload[out], uncompressed_size) != uncompressed_size) {
+			return false;
+		}
+
+		in += compressed_size;
+		out += uncompressed_size;
+	}
+
+	return out == payload_size;
+}
+
+//pull the uncompressed payload out of the formats we write, these are what the settings actually apply to
+bool LoadPayload(const std::string &filename, std::vector<char> &payload) {
+	std::vector<char> file;
+	if (!ReadFile(filename, file) || file.empty()) {
+		return false;
+	}
+
+	if (file.size() >= 13 && memcmp(&file[0], "EQNAVMESH", 9) == 0) {
+		return InflatePayload(file, 13, payload);
+	}
+
+	if (file.size() >= 4) {
+		uint32_t version = *(uint32_t*)&file[0];
+		if (version == 0x02000000) {
+			return InflatePayload(file, 4, payload);
+		}
+
+		if (version == 0x02010000) {
+			return InflateChunkedPayload(file, 4, payload);
+		}
+	}
+
+	payload.swap(file);
+	return true;
+}
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Run(const std::vector<char> &payload, const EQEmu::CompressionOptions &opts, Result &res) {
+	uint32_t in_size = (uint32_t)payload.size();
+	std::vector<char> compressed(EQEmu::DeflateBound(in_size, opts));
+	std::vector<char> decompressed(payload.size());
+
+	uint32_t out_size = 0;
+	uint32_t iterations = 0;
+	auto start = std::chrono::steady_clock::now();
+	double elapsed = 0.0;
+	do {
+		out_size = EQEmu::DeflateData(&payload[0], in_size, &compressed[0], (uint32_t)compressed.size(), opts);
+		if (out_size == 0) {
+			return false;
+		}
+
+		++iterations;
+		elapsed = Seconds(start);
+	} while (elapsed < MIN_BENCH_SECONDS);
+
+	res.in_size = in_size;
+	res.out_size = out_size;
+	res.compress_seconds = elapsed / iterations;
+
+	iterations = 0;
+	start = std::chrono::steady_clock::now();
+	do {
+		if (EQEmu::InflateData(&compressed[0], out_size, &decompressed[0], in_size) != in_size) {
+			return false;
+		}
+
+		++iterations;
+		elapsed = Seconds(start);
+	} while (elapsed < MIN_BENCH_SECONDS);
+
+	res.decompress_seconds = elapsed / iterations;
+	return memcmp(&payload[0], &decompressed[0], payload.size()) == 0;
+}
+
+void PrintResult(const char *name, const Result &res) {
+	double mb = res.in_size / (1024.0 * 1024.0);
+	printf("  %-16s %12llu %7.2f%% %10.1f %10.1f\n", name, (unsigned long long)res.out_size,
+		res.in_size > 0 ? 100.0 * res.out_size / res.in_size : 0.0,
+		res.compress_seconds > 0.0 ? mb / res.compress_seconds : 0.0,
+		res.decompress_seconds > 0.0 ? mb / res.decompress_seconds : 0.0);
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Setting> settings;
+	const int levels[] = { 1, 2, 4, 6, 9 };
+	for (int level : levels) {
+		char name[32];
+		snprintf(name, sizeof(name), "level %d", level);
+		settings.push_back({ name, EQEmu::CompressionOptions(level, Z_DEFAULT_STRATEGY) });
+
+		snprintf(name, sizeof(name), "level %d filtered", level);
+		settings.push_back({ name, EQEmu::CompressionOptions(level, Z_FILTERED) });
+	}
+	settings.push_back({ "rle", EQEmu::CompressionOptions(1, Z_RLE) });
+	settings.push_back({ "huffman", EQEmu::CompressionOptions(1, Z_HUFFMAN_ONLY) });
+
+	std::vector<Result> totals(settings.size(), Result{ 0, 0, 0.0, 0.0 });
+	int loaded = 0;
+	for (int i = 1; i < argc; ++i) {
+		std::vector<char> payload;
+		if (!LoadPayload(argv[i], payload) || payload.empty()) {
+			printf("Unable to load %s\n", argv[i]);
+			continue;
+		}
+
+		printf("%s: %llu bytes\n", argv[i], (unsigned long long)payload.size());
+		printf("  %-16s %12s %8s %10s %10s\n", "setting", "size", "ratio", "comp MB/s", "decomp MB/s");
+		for (size_t j = 0; j < settings.size(); ++j) {
+			Result res;
+			if (!Run(payload, settings[j].opts, res)) {
+				printf("  %-16s failed\n", settings[j].name.c_str());
+				continue;
+			}
+
+			PrintResult(settings[j].name.c_str(), res);
+			totals[j].in_size += res.in_size;
+			totals[j].out_size += res.out_size;
+			totals[j].compress_seconds += res.compress_seconds;
+			totals[j].decompress_seconds += res.decompress_seconds;
+		}
+
+		++loaded;
+	}
+
+	if (loaded > 1) {
+		printf("All files:\n");
+		printf("  %-16s %12s %8s %10s %10s\n", "setting", "size", "ratio", "comp MB/s", "decomp MB/s");
+		for (size_t j = 0; j < settings.size(); ++j) {
+			PrintResult(settings[j].name.c_str(), totals[j]);
+		}
+	}
+
+	return loaded > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -20,6 +20,7 @@ EQEmu::Log::Manager &EQEmu::Log::Manager::Instance() {
 }
 
 void EQEmu::Log::Manager::RegisterLog(std::shared_ptr<EQEmu::Log::LogBase> log) {
+	std::lock_guard<std::mutex> guard(lock);
 	log->OnRegister(enabled_logs);
 	logs.push_back(log);
 }
@@ -41,6 +42,7 @@ void EQEmu::Log::Manager::Log(LogType type, const char *str, ...) {
 }
 
 void EQEmu::Log::Manager::DispatchMessage(LogType type, const std::string &message) {
+	std::lock_guard<std::mutex> guard(lock);
 	size_t sz = logs.size();
 	for(size_t i = 0; i < sz; ++i) {
 		logs[i]->OnMessage(type, message);
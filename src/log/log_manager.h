@@ -4,6 +4,7 @@
 #include "log_base.h"
 #include <vector>
 #include <memory>
+#include <mutex>
 
 namespace EQEmu
 {
@@ -28,6 +29,8 @@ private:
 	
 	int enabled_logs;
 	std::vector<std::shared_ptr<LogBase>> logs;
+	//messages can come from any thread, sinks only ever see one at a time
+	std::mutex lock;
 };
 
 }
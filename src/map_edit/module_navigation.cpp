@@ -759,6 +759,9 @@ bool VertexWithinBounds(const glm::vec3 &v, glm::vec3 &min, glm::vec3 &max) {
 
 void ModuleNavigation::CreateChunkyTriMesh(std::shared_ptr<ZoneMap> zone_geo)
 {
+	//recast needs plain triangles, the first build or load expands the placeables (and drops the
+	//shared models) so the tile builders read them out of the collidable vert/ind lists
+	zone_geo->Flatten();
 
 	//only include tris within bb of zone
 	std::vector<int> inds;
@@ -1483,59 +1486,78 @@ void ModuleNavigation::SaveNavMesh()
 	if (!m_nav_mesh)
 		return;
 
-	std::string filename = Config::Instance().GetPath("nav", "maps/nav/") + "/" + m_scene->GetZoneName() + ".nav";
-	FILE *f = fopen(filename.c_str(), "wb");
+	const dtNavMesh *mesh = m_nav_mesh;
+	std::stringstream ss(std::stringstream::in | std::stringstream::out | std::stringstream::binary);
 
-	if (f) {
-		const dtNavMesh *mesh = m_nav_mesh;
-		char magic[9] = { 'E', 'Q', 'N', 'A', 'V', 'M', 'E', 'S', 'H' };
-		fwrite(magic, sizeof(magic), 1, f);
-		fwrite(&nav_mesh_file_version, sizeof(uint32_t), 1, f);
+	uint32_t number_of_tiles = 0;
+	for (int i = 0; i < m_nav_mesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = mesh->getTile(i);
+		if (!tile || !tile->header || !tile->dataSize) 
+			continue;
+		number_of_tiles++;
+	}
 
-		std::stringstream ss(std::stringstream::in | std::stringstream::out | std::stringstream::binary);
+	ss.write((const char*)&number_of_tiles, sizeof(uint32_t));
 
-		uint32_t number_of_tiles = 0;
-		for (int i = 0; i < m_nav_mesh->getMaxTiles(); ++i)
-		{
-			const dtMeshTile* tile = mesh->getTile(i);
-			if (!tile || !tile->header || !tile->dataSize) 
-				continue;
-			number_of_tiles++;
-		}
+	dtNavMeshParams params;
+	memcpy(&params, mesh->getParams(), sizeof(dtNavMeshParams));
+	ss.write((const char*)&params, sizeof(dtNavMeshParams));
 
-		ss.write((const char*)&number_of_tiles, sizeof(uint32_t));
+	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = mesh->getTile(i);
+		if (!tile || !tile->header || !tile->dataSize) 
+			continue;
 
-		dtNavMeshParams params;
-		memcpy(&params, mesh->getParams(), sizeof(dtNavMeshParams));
-		ss.write((const char*)&params, sizeof(dtNavMeshParams));
+		//write tileref uint32
+		uint32_t tile_ref = mesh->getTileRef(tile);
+		ss.write((const char*)&tile_ref, sizeof(uint32_t));
 
-		for (int i = 0; i < mesh->getMaxTiles(); ++i)
-		{
-			const dtMeshTile* tile = mesh->getTile(i);
-			if (!tile || !tile->header || !tile->dataSize) 
-				continue;
+		//write datasize int32
+		int32_t data_size = tile->dataSize;
+		ss.write((const char*)&data_size, sizeof(int32_t));
 
-			//write tileref uint32
-			uint32_t tile_ref = mesh->getTileRef(tile);
-			ss.write((const char*)&tile_ref, sizeof(uint32_t));
+		ss.write((const char*)tile->data, data_size);
+	}
 
-			//write datasize int32
-			int32_t data_size = tile->dataSize;
-			ss.write((const char*)&data_size, sizeof(int32_t));
+	std::string filename = Config::Instance().GetPath("nav", "maps/nav/") + "/" + m_scene->GetZoneName() + ".nav";
 
-			ss.write((const char*)tile->data, data_size);
-		}
+	//compressed before the file is opened so a failure leaves any existing .nav alone
+	std::string payload = ss.str();
+	uint32_t uncompressed_size = (uint32_t)payload.length();
+	auto compression = Config::Instance().GetCompression("nav", EQEmu::CompressionOptions());
+	std::vector<char> buffer;
+	auto buffer_len = EQEmu::DeflateBound(uncompressed_size, compression);
+	buffer.resize(buffer_len);
+
+	uint32_t out_size = (uint32_t)EQEmu::DeflateData(payload.c_str(), uncompressed_size, &buffer[0], buffer_len, compression);
+	if (out_size == 0) {
+		eqLogMessage(LogError, "Failed to write %s because the nav mesh could not be compressed.", filename.c_str());
+		return;
+	}
 
-		std::vector<char> buffer;
-		auto buffer_len = ss.str().length() + 128;
-		buffer.resize(buffer_len);
-
-		uint32_t out_size = (uint32_t)EQEmu::DeflateData(ss.str().c_str(), (uint32_t)ss.str().length(), &buffer[0], buffer_len);
-		fwrite(&out_size, sizeof(uint32_t), 1, f);
-		uint32_t uncompressed_size = (uint32_t)ss.str().length();
-		fwrite(&uncompressed_size, sizeof(uint32_t), 1, f);
-		fwrite(&buffer[0], out_size, 1, f);
-		fclose(f);
+	FILE *f = fopen(filename.c_str(), "wb");
+	if (!f) {
+		eqLogMessage(LogError, "Failed to write %s because the file could not be opened to write.", filename.c_str());
+		return;
+	}
+
+	char magic[9] = { 'E', 'Q', 'N', 'A', 'V', 'M', 'E', 'S', 'H' };
+	bool ok = fwrite(magic, sizeof(magic), 1, f) == 1 &&
+		fwrite(&nav_mesh_file_version, sizeof(uint32_t), 1, f) == 1 &&
+		fwrite(&out_size, sizeof(uint32_t), 1, f) == 1 &&
+		fwrite(&uncompressed_size, sizeof(uint32_t), 1, f) == 1 &&
+		fwrite(&buffer[0], out_size, 1, f) == 1;
+
+	if (fclose(f) != 0) {
+		ok = false;
+	}
+
+	//a partial file would fail to load later with nothing to say why
+	if (!ok) {
+		eqLogMessage(LogError, "Failed to write %s, removing the partial file.", filename.c_str());
+		remove(filename.c_str());
 	}
 }
 
@@ -131,6 +131,28 @@ void Scene::Init(GLFWwindow *win) {
 	m_tint = m_shader->GetUniformLocation("Tint");
 }
 
+static StaticGeometry *CreateWorldGeometry(EQEmu::Span<const glm::vec3> verts, EQEmu::Span<const unsigned int> inds, const glm::vec3 &color) {
+	StaticGeometry *m = new StaticGeometry();
+	m->GetVerts().assign(verts.begin(), verts.end());
+	m->GetInds().assign(inds.begin(), inds.end());
+	m->GetVertColors().assign(verts.size(), color);
+	m->Compile();
+	return m;
+}
+
+//each shared model is uploaded once and drawn at every instance, empty models get no entity
+static void CreateModelGeometry(EQEmu::Span<const EQEmu::InstancedModel> models, const glm::vec3 &color, std::vector<std::unique_ptr<Entity>> &out) {
+	out.clear();
+	for (auto &model : models) {
+		if (model.inds.empty()) {
+			out.emplace_back();
+			continue;
+		}
+
+		out.emplace_back(CreateWorldGeometry(model.verts, model.inds, color));
+	}
+}
+
 void Scene::LoadScene(const char *zone_name) {
 	m_name = zone_name;
 	m_hor_angle = 3.14f;
@@ -147,34 +169,33 @@ void Scene::LoadScene(const char *zone_name) {
 		if (!w_map) {
 			w_map = WaterMap::LoadWaterMapfile(Config::Instance().GetPath("water", "maps/water") + "/", zone_name);
 		}
-		m_physics->RegisterMesh("CollideWorldMesh", m_zone_geometry->GetCollidableVerts(), m_zone_geometry->GetCollidableInds(), 
-			glm::vec3(0.0f, 0.0f, 0.0f), EQPhysicsFlags::CollidableWorld);
-		m_physics->RegisterMesh("NonCollideWorldMesh", m_zone_geometry->GetNonCollidableVerts(), m_zone_geometry->GetNonCollidableInds(), 
-			glm::vec3(0.0f, 0.0f, 0.0f), EQPhysicsFlags::NonCollidableWorld);
-		m_physics->SetWaterMap(w_map);
-
-		//create models from the loaded stuff here...
-		StaticGeometry *m = new StaticGeometry();
-		m->GetVerts() = m_zone_geometry->GetCollidableVerts();
-		m->GetInds() = m_zone_geometry->GetCollidableInds();
-		size_t sz = m->GetVerts().size();
-		for (size_t i = 0; i < sz; ++i) {
-			m->GetVertColors().push_back(glm::vec3(0.8f, 0.8f, 0.8f));
+		//only what was actually loaded goes into bullet
+		uint32_t loaded = m_zone_geometry->GetLoadFlags();
+		if (loaded & MapLoadCollidable) {
+			m_physics->RegisterMesh("CollideWorldMesh", m_zone_geometry->GetCollidableVerts(), m_zone_geometry->GetCollidableInds(), 
+				glm::vec3(0.0f, 0.0f, 0.0f), EQPhysicsFlags::CollidableWorld);
+			m_physics->RegisterInstances("CollideWorldInstances", m_zone_geometry->GetCollidableModels(), m_zone_geometry->GetInstances(),
+				EQPhysicsFlags::CollidableWorld);
 		}
 
-		m->Compile();
-		m_collide_mesh_entity.reset(m);
-
-		m = new StaticGeometry();
-		m->GetVerts() = m_zone_geometry->GetNonCollidableVerts();
-		m->GetInds() = m_zone_geometry->GetNonCollidableInds();
-		sz = m->GetVerts().size();
-		for (size_t i = 0; i < sz; ++i) {
-			m->GetVertColors().push_back(glm::vec3(0.5f, 0.7f, 1.0f));
+		if (loaded & MapLoadNonCollidable) {
+			m_physics->RegisterMesh("NonCollideWorldMesh", m_zone_geometry->GetNonCollidableVerts(), m_zone_geometry->GetNonCollidableInds(), 
+				glm::vec3(0.0f, 0.0f, 0.0f), EQPhysicsFlags::NonCollidableWorld);
+			m_physics->RegisterInstances("NonCollideWorldInstances", m_zone_geometry->GetNonCollidableModels(), m_zone_geometry->GetInstances(),
+				EQPhysicsFlags::NonCollidableWorld);
 		}
+		m_physics->SetWaterMap(w_map);
 
-		m->Compile();
-		m_non_collide_mesh_entity.reset(m);
+		//placeables are drawn from the shared models, only a consumer that needs plain triangles
+		//(navmesh building) flattens the map
+		m_collide_mesh_entity.reset(CreateWorldGeometry(m_zone_geometry->GetCollidableVerts(), m_zone_geometry->GetCollidableInds(),
+			glm::vec3(0.8f, 0.8f, 0.8f)));
+		m_non_collide_mesh_entity.reset(CreateWorldGeometry(m_zone_geometry->GetNonCollidableVerts(), m_zone_geometry->GetNonCollidableInds(),
+			glm::vec3(0.5f, 0.7f, 1.0f)));
+		CreateModelGeometry(m_zone_geometry->GetCollidableModels(), glm::vec3(0.8f, 0.8f, 0.8f), m_collide_model_entities);
+		CreateModelGeometry(m_zone_geometry->GetNonCollidableModels(), glm::vec3(0.5f, 0.7f, 1.0f), m_non_collide_model_entities);
+		auto instances = m_zone_geometry->GetInstances();
+		m_instances.assign(instances.begin(), instances.end());
 
 		m_bounding_box_min = m_zone_geometry->GetCollidableMin();
 		m_bounding_box_max = m_zone_geometry->GetCollidableMax();
@@ -183,6 +204,9 @@ void Scene::LoadScene(const char *zone_name) {
 	else {
 		m_collide_mesh_entity.release();
 		m_non_collide_mesh_entity.release();
+		m_collide_model_entities.clear();
+		m_non_collide_model_entities.clear();
+		m_instances.clear();
 	}
 
 	for(auto &module : m_modules) {
@@ -190,6 +214,32 @@ void Scene::LoadScene(const char *zone_name) {
 	}
 }
 
+void Scene::RenderInstances(std::vector<std::unique_ptr<Entity>> &models) {
+	for (auto &instance : m_instances) {
+		if (instance.model >= models.size() || !models[instance.model]) {
+			continue;
+		}
+
+		auto &entity = models[instance.model];
+		glm::mat4 model = glm::mat4(instance.transform);
+		m_model.SetValueMatrix4(1, false, &model[0][0]);
+
+		glm::vec4 tint = entity->GetTint();
+		m_tint.SetValuePtr4(1, &tint[0]);
+		entity->Draw();
+
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		tint = glm::vec4(0.0f);
+		m_tint.SetValuePtr4(1, &tint[0]);
+		entity->Draw();
+
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	}
+
+	glm::mat4 model = glm::mat4(1.0);
+	m_model.SetValueMatrix4(1, false, &model[0][0]);
+}
+
 void Scene::Render() {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 	ImGui_ImplOpenGL3_NewFrame();
@@ -226,6 +276,7 @@ void Scene::Render() {
 		m_collide_mesh_entity->Draw();
 
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		RenderInstances(m_collide_model_entities);
 	}
 
 	if(m_render_non_collide && m_non_collide_mesh_entity) {
@@ -242,6 +293,7 @@ void Scene::Render() {
 		m_non_collide_mesh_entity->Draw();
 
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		RenderInstances(m_non_collide_model_entities);
 	}
 
 	if (m_render_bb && m_bounding_box_renderable) {
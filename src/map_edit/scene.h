@@ -84,6 +84,7 @@ public:
 private:
 	void GetEntityName(Entity *ent, std::string &name);
 	void GetClickVectors(double x, double y, glm::vec3 &start, glm::vec3 &end, int width, int height);
+	void RenderInstances(std::vector<std::unique_ptr<Entity>> &models);
 	friend class Module;
 	Scene(const Scene&);
 	Scene& operator=(const Scene&);
@@ -119,6 +120,10 @@ private:
 	ShaderUniform m_tint;
 	std::unique_ptr<Entity> m_collide_mesh_entity;
 	std::unique_ptr<Entity> m_non_collide_mesh_entity;
+	//one entity per shared model, drawn at each of m_instances
+	std::vector<std::unique_ptr<Entity>> m_collide_model_entities;
+	std::vector<std::unique_ptr<Entity>> m_non_collide_model_entities;
+	std::vector<EQEmu::MeshInstance> m_instances;
 	std::map<Module*, std::vector<Entity*>> m_registered_entities;
 
 	//bounds
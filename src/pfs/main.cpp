@@ -1,12 +1,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
 #include "pfs.h"
+#include "string_util.h"
+#include "thread_pool.h"
 
 enum CommandType
 {
 	CommandUnknown,
 	CommandAdd,
+	CommandCompact,
 	CommandDelete,
 	CommandExtract,
 	CommandList,
@@ -14,18 +20,26 @@ enum CommandType
 };
 
 void PrintUsage() {
-	printf("Usage: pfs [<switches>...] <command> <command args>... <archive_name> [<file_names>...]\n"
+	printf("Usage: pfs [<switches>...] <command> <command args>... <archive_names> [<file_names>...]\n"
 	"<Switches>\n"
 	" -i=dir: Set input directory\n"
 	" -o=dir: Set output directory\n"
+	" -l=level: Set the compression level used for new or changed files, 0-9 (default 4)\n"
+	" -j=count: Number of files and archives to work on at once, 0 uses every core (default 1)\n"
 	"<Commands>\n"
 	" a: Add files to archive\n"
+	" c: Compact the archive, reclaiming space left behind by deleted or updated files\n"
 	" d: Delete files from the archive\n"
 	" e: Extract files from the archive\n"
 	" l: List contents of the archive\n"
 	" <Command Args>\n"
 	"  arg1: Only search for files with this extension, may use * as a wildcard meaning all extensions\n"
 	" u: Update files of the archive\n"
+	"<Archive names>\n"
+	" A comma separated list of archives in the input directory, each may use * and ? wildcards.\n"
+	" When more than one archive is matched, extracted files go to a directory per archive.\n"
+	"<File names>\n"
+	" May use * and ? wildcards, matched against the archive for e/d and the current directory for a/u.\n"
 	);
 }
 
@@ -65,6 +79,242 @@ bool WriteFile(std::string filename, const std::vector<char> &buffer) {
 	return false;
 }
 
+struct CommandOptions
+{
+	CommandType command;
+	std::string input_dir;
+	std::string output_dir;
+	std::vector<std::string> files;
+	EQEmu::CompressionOptions compression;
+	//extract each archive into its own directory, set when more than one archive is being worked on
+	bool archive_dirs;
+};
+
+//expands a comma separated list of archive names and wildcards against the input directory
+bool ExpandArchives(const std::string &input_dir, const std::string &names, std::vector<std::string> &out_archives) {
+	auto list = EQEmu::SplitString(names, ',');
+	for (auto &name : list) {
+		if (name.empty()) {
+			continue;
+		}
+
+		if (!EQEmu::HasWildcard(name)) {
+			out_archives.push_back(name);
+			continue;
+		}
+
+		std::error_code ec;
+		std::vector<std::string> matches;
+		for (auto &entry : std::filesystem::directory_iterator(input_dir, ec)) {
+			std::error_code type_ec;
+			if (!entry.is_regular_file(type_ec)) {
+				continue;
+			}
+
+			std::string filename = entry.path().filename().string();
+			if (EQEmu::WildcardMatch(name, filename)) {
+				matches.push_back(filename);
+			}
+		}
+
+		if (ec || matches.empty()) {
+			printf("Warning: No archives in %s match %s\n", input_dir.c_str(), name.c_str());
+			continue;
+		}
+
+		std::sort(matches.begin(), matches.end());
+		out_archives.insert(out_archives.end(), matches.begin(), matches.end());
+	}
+
+	std::sort(out_archives.begin(), out_archives.end());
+	out_archives.erase(std::unique(out_archives.begin(), out_archives.end()), out_archives.end());
+	return !out_archives.empty();
+}
+
+//wildcards in file names are matched against the contents of the archive
+void ExpandArchiveFiles(EQEmu::PFS::Archive &archive, const std::vector<std::string> &files, std::vector<std::string> &out_files) {
+	std::vector<std::string> all;
+	for (auto &file : files) {
+		if (!EQEmu::HasWildcard(file)) {
+			out_files.push_back(file);
+			continue;
+		}
+
+		if (all.empty()) {
+			archive.GetFilenames("*", all);
+		}
+
+		for (auto &name : all) {
+			if (EQEmu::WildcardMatch(file, name)) {
+				out_files.push_back(name);
+			}
+		}
+	}
+}
+
+//wildcards in file names are matched against the current directory
+void ExpandLocalFiles(const std::vector<std::string> &files, std::vector<std::string> &out_files) {
+	for (auto &file : files) {
+		if (!EQEmu::HasWildcard(file)) {
+			out_files.push_back(file);
+			continue;
+		}
+
+		std::error_code ec;
+		std::vector<std::string> matches;
+		for (auto &entry : std::filesystem::directory_iterator(".", ec)) {
+			std::error_code type_ec;
+			if (!entry.is_regular_file(type_ec)) {
+				continue;
+			}
+
+			std::string filename = entry.path().filename().string();
+			if (EQEmu::WildcardMatch(file, filename)) {
+				matches.push_back(filename);
+			}
+		}
+
+		std::sort(matches.begin(), matches.end());
+		out_files.insert(out_files.end(), matches.begin(), matches.end());
+	}
+}
+
+bool ListArchive(const std::string &input_file, const std::string &ext) {
+	EQEmu::PFS::Archive archive;
+	if (!archive.Open(input_file)) {
+		printf("Unable to open archive %s\n", input_file.c_str());
+		return false;
+	}
+
+	std::vector<std::string> files;
+	archive.GetFilenames(ext, files);
+
+	printf("Files with extension %s in %s:\n", ext.c_str(), input_file.c_str());
+	for(uint32_t i = 0; i < files.size(); ++i) {
+		printf("%s\n", files[i].c_str());
+	}
+
+	return true;
+}
+
+bool ProcessArchive(EQEmu::ThreadPool &pool, const CommandOptions &opts, const std::string &archive_name) {
+	std::string output_file = opts.output_dir + "/" + archive_name;
+	std::string input_file = opts.input_dir + "/" + archive_name;
+
+	EQEmu::PFS::Archive archive;
+	bool existing_archive = archive.Open(input_file);
+	if (!existing_archive) {
+		if (opts.command == CommandCompact || opts.command == CommandExtract) {
+			printf("Unable to open archive %s\n", input_file.c_str());
+			return false;
+		}
+
+		archive.Open();
+	}
+
+	archive.SetCompressionOptions(opts.compression);
+
+	if(opts.command == CommandAdd || opts.command == CommandUpdate) {
+		std::vector<std::string> files;
+		ExpandLocalFiles(opts.files, files);
+
+		//files are read in parallel but the archive itself is only touched from this thread
+		std::vector<std::vector<char>> contents(files.size());
+		std::vector<char> found(files.size(), 0);
+		pool.ParallelFor(files.size(), [&](size_t i) {
+			bool exists = archive.Exists(files[i]);
+			if (opts.command == CommandAdd && exists) {
+				printf("Warning: Could not add %s to the archive, file with that name already exists.\n", files[i].c_str());
+				return;
+			}
+
+			if (opts.command == CommandUpdate && !exists) {
+				printf("Warning: Could not update %s in the archive, file with that name does not exist.\n", files[i].c_str());
+				return;
+			}
+
+			if(!ReadFile(files[i], contents[i])) {
+				if (opts.command == CommandAdd) {
+					printf("Warning: Could not find %s to add to archive.\n", files[i].c_str());
+				} else {
+					printf("Warning: Could not find %s to update in archive.\n", files[i].c_str());
+				}
+				return;
+			}
+
+			found[i] = 1;
+		});
+
+		for (size_t i = 0; i < files.size(); ++i) {
+			if (found[i]) {
+				archive.Set(files[i], contents[i]);
+				std::vector<char>().swap(contents[i]);
+			}
+		}
+	} else if(opts.command == CommandDelete) {
+		std::vector<std::string> files;
+		ExpandArchiveFiles(archive, opts.files, files);
+		for (size_t i = 0; i < files.size(); ++i) {
+			if (!archive.Delete(files[i])) {
+				printf("Warning: Could not delete %s from the archive.\n", files[i].c_str());
+			}
+		}
+	} else if (opts.command == CommandExtract) {
+		std::vector<std::string> files;
+		ExpandArchiveFiles(archive, opts.files, files);
+
+		std::string dir = opts.output_dir;
+		if (opts.archive_dirs) {
+			std::string sub = archive_name;
+			std::replace(sub.begin(), sub.end(), '.', '_');
+			dir += "/" + sub;
+
+			std::error_code ec;
+			std::filesystem::create_directories(dir, ec);
+		}
+
+		//every worker inflates and writes its own files so decompression and disk writes overlap
+		pool.ParallelFor(files.size(), [&](size_t i) {
+			std::vector<char> current_file;
+			if (!archive.Exists(files[i])) {
+				printf("Warning: Could not extract %s from the archive, file with that name does not exist.\n", files[i].c_str());
+				return;
+			}
+
+			if(!archive.Get(files[i], current_file)) {
+				printf("Warning: Could not extract %s from the archive, could not find file in archive.\n", files[i].c_str());
+				return;
+			}
+
+			std::string filename_out = dir + "/" + files[i];
+
+			if (!WriteFile(filename_out, current_file)) {
+				printf("Warning: Could not extract %s from the archive, could not write file to output directory.\n", files[i].c_str());
+				return;
+			}
+		});
+
+		return true;
+	}
+
+	//changes to an archive we're writing back over are appended in place, compacting rewrites it fully
+	if (opts.command != CommandCompact && existing_archive && input_file.compare(output_file) == 0) {
+		if (!archive.SaveInPlace()) {
+			printf("Error: Could not update archive %s\n", output_file.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	if (!archive.Save(output_file)) {
+		printf("Error: Could not save archive to %s\n", output_file.c_str());
+		return false;
+	}
+
+	return true;
+}
+
 int main(int argc, char **argv) {
 
 	if(argc < 2) {
@@ -74,28 +324,36 @@ int main(int argc, char **argv) {
 
 	int argi = 1;
 
-	std::string input_dir = ".";
-	std::string output_dir = ".";
+	CommandOptions opts;
+	opts.command = CommandUnknown;
+	opts.input_dir = ".";
+	opts.output_dir = ".";
+	opts.archive_dirs = false;
+	size_t jobs = 1;
 
-	while (strlen(argv[argi]) > 3 && argv[argi][0] == '-') {
+	while (argi < argc && strlen(argv[argi]) > 3 && argv[argi][0] == '-') {
 		if (argv[argi][1] == 'i' && argv[argi][2] == '=') {
-			size_t str_sz = strlen(argv[argi]) - 3;
-			if(str_sz == 0) {
+			opts.input_dir = &argv[argi][3];
+		} else if (argv[argi][1] == 'o' && argv[argi][2] == '=') {
+			opts.output_dir = &argv[argi][3];
+		} else if (argv[argi][1] == 'l' && argv[argi][2] == '=') {
+			char *end = nullptr;
+			long level = strtol(&argv[argi][3], &end, 10);
+			if (*end != 0 || level < 0 || level > 9) {
 				PrintUsage();
 				return EXIT_FAILURE;
 			}
 
-			input_dir.resize(str_sz);
-			memcpy(&input_dir[0], &argv[argi][3], str_sz);
-		} else if (argv[argi][1] == 'o' && argv[argi][2] == '=') {
-			size_t str_sz = strlen(argv[argi]) - 3;
-			if (str_sz == 0) {
+			opts.compression.level = (int)level;
+		} else if (argv[argi][1] == 'j' && argv[argi][2] == '=') {
+			char *end = nullptr;
+			long count = strtol(&argv[argi][3], &end, 10);
+			if (*end != 0 || count < 0) {
 				PrintUsage();
 				return EXIT_FAILURE;
 			}
 
-			output_dir.resize(str_sz);
-			memcpy(&output_dir[0], &argv[argi][3], str_sz);
+			jobs = count == 0 ? std::max(std::thread::hardware_concurrency(), 1U) : (size_t)count;
 		} else {
 			PrintUsage();
 			return EXIT_FAILURE;
@@ -104,25 +362,31 @@ int main(int argc, char **argv) {
 		argi++;
 	}
 
+	if (argi >= argc) {
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
 
-	CommandType current_command = CommandUnknown;
 	if (strcmp(argv[argi], "a") == 0) {
-		current_command = CommandAdd;
+		opts.command = CommandAdd;
+	}
+	else if (strcmp(argv[argi], "c") == 0) {
+		opts.command = CommandCompact;
 	}
 	else if (strcmp(argv[argi], "d") == 0) {
-		current_command = CommandDelete;
+		opts.command = CommandDelete;
 	}
 	else if (strcmp(argv[argi], "e") == 0) {
-		current_command = CommandExtract;
+		opts.command = CommandExtract;
 	}
 	else if (strcmp(argv[argi], "l") == 0) {
-		current_command = CommandList;
+		opts.command = CommandList;
 	}
 	else if (strcmp(argv[argi], "u") == 0) {
-		current_command = CommandUpdate;
+		opts.command = CommandUpdate;
 	}
 
-	if(current_command == CommandUnknown) {
+	if(opts.command == CommandUnknown) {
 		printf("Invalid command argument %s\n", argv[argi]);
 		PrintUsage();
 		return EXIT_FAILURE;
@@ -130,126 +394,54 @@ int main(int argc, char **argv) {
 
 	argi++;
 
-	std::string input_file;
-	std::string output_file;
-	std::vector<std::string> files;
-	if(current_command == CommandList) {
-		std::string ext;
+	std::string ext;
+	if (opts.command == CommandList) {
 		if (argc < argi + 1) {
 			PrintUsage();
 			return EXIT_FAILURE;
 		}
 
 		ext = argv[argi++];
+	}
 
-		if (argc < argi + 1) {
-			PrintUsage();
-			return EXIT_FAILURE;
-		}
-
-		input_file = argv[argi++];
-		input_file = input_dir + "/" + input_file;
-
-		EQEmu::PFS::Archive archive;
-		if (!archive.Open(input_file)) {
-			printf("Unable to open archive %s\n", input_file.c_str());
-			return EXIT_FAILURE;
-		}
-		
-		std::vector<std::string> files;
-		archive.GetFilenames(ext, files);
-		
-		printf("Files with extension %s in %s:\n", ext.c_str(), input_file.c_str());
-		for(uint32_t i = 0; i < files.size(); ++i) {
-			printf("%s\n", files[i].c_str());
-		}
-
-		return EXIT_SUCCESS;
-	} else {
-		if (argc < argi + 1) {
-			PrintUsage();
-			return EXIT_FAILURE;
-		}
-
-		input_file = argv[argi++];
-		output_file = output_dir + "/" + input_file;
-		input_file = input_dir + "/" + input_file;
-
-		for (int i = argi; i < argc; ++i) {
-			files.push_back(argv[i]);
-		}
+	if (argc < argi + 1) {
+		PrintUsage();
+		return EXIT_FAILURE;
 	}
 
-	EQEmu::PFS::Archive archive;
-	if (!archive.Open(input_file)) {
-		archive.Open();
+	std::string archive_names = argv[argi++];
+	for (int i = argi; i < argc; ++i) {
+		opts.files.push_back(argv[i]);
 	}
 
-	if(current_command == CommandAdd) {
-		std::vector<char> current_file;
-		for(size_t i = 0; i < files.size(); ++i) {
-			if (archive.Exists(files[i])) {
-				printf("Warning: Could not add %s to the archive, file with that name already exists.\n", files[i].c_str());
-				continue;
-			}
+	std::vector<std::string> archives;
+	if (!ExpandArchives(opts.input_dir, archive_names, archives)) {
+		printf("Unable to find any archives matching %s\n", archive_names.c_str());
+		return EXIT_FAILURE;
+	}
 
-			if(!ReadFile(files[i], current_file)) {
-				printf("Warning: Could not find %s to add to archive.\n", files[i].c_str());
-				continue;
-			} else {
-				archive.Set(files[i], current_file);
+	if (opts.command == CommandList) {
+		bool success = true;
+		for (auto &archive_name : archives) {
+			if (!ListArchive(opts.input_dir + "/" + archive_name, ext)) {
+				success = false;
 			}
 		}
-	} else if(current_command == CommandDelete) {
-		for (size_t i = 0; i < files.size(); ++i) {
-			if (!archive.Delete(files[i])) {
-				printf("Warning: Could not delete %s from the archive.\n", files[i].c_str());
-			}
-		}
-	} else if (current_command == CommandExtract) {
-		std::vector<char> current_file;
-		for (size_t i = 0; i < files.size(); ++i) {
-			if (!archive.Exists(files[i])) {
-				printf("Warning: Could not extract %s from the archive, file with that name does not exist.\n", files[i].c_str());
-				continue;
-			}
-
-			if(!archive.Get(files[i], current_file)) {
-				printf("Warning: Could not extract %s from the archive, could not find file in archive.\n", files[i].c_str());
-				continue;
-			}
 
-			std::string filename_out = output_dir + "/" + files[i];
+		return success ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
 
-			if (!WriteFile(filename_out, current_file)) {
-				printf("Warning: Could not extract %s from the archive, could not write file to output directory.\n", files[i].c_str());
-				continue;
-			}
-		}
+	opts.archive_dirs = archives.size() > 1;
 
-		return EXIT_SUCCESS;
-	} else if (current_command == CommandUpdate) {
-		std::vector<char> current_file;
-		for (size_t i = 0; i < files.size(); ++i) {
-			if (!archive.Exists(files[i])) {
-				printf("Warning: Could not update %s in the archive, file with that name does not exist.\n", files[i].c_str());
-				continue;
-			}
-
-			if (!ReadFile(files[i], current_file)) {
-				printf("Warning: Could not find %s to update in archive.\n", files[i].c_str());
-				continue;
-			}
-			else {
-				archive.Set(files[i], current_file);
-			}
+	//archives are spread over the pool and each one spreads its files over it too,
+	//ParallelFor has the caller take work so nesting them is safe
+	EQEmu::ThreadPool pool(jobs);
+	std::atomic<bool> success(true);
+	pool.ParallelFor(archives.size(), [&](size_t i) {
+		if (!ProcessArchive(pool, opts, archives[i])) {
+			success = false;
 		}
-	}
+	});
 
-	if (!archive.Save(output_file)) {
-		printf("Error: Could not save archive to %s\n", output_file.c_str());
-		return EXIT_FAILURE;
-	}
-	
-	return EXIT_SUCCESS;
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
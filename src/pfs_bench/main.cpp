@@ -0,0 +1,356 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <filesystem>
+#include "pfs.h"
+#include "compression.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+//every operator new in the process goes through here so each phase can report what it allocated,
+//zlib allocates through malloc so its stream state isn't included
+static std::atomic<uint64_t> alloc_count(0);
+static std::atomic<uint64_t> alloc_bytes(0);
+
+void *operator new(size_t sz) {
+	alloc_count.fetch_add(1, std::memory_order_relaxed);
+	alloc_bytes.fetch_add(sz, std::memory_order_relaxed);
+	void *p = malloc(sz == 0 ? 1 : sz);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+
+	return p;
+}
+
+void *operator new[](size_t sz) {
+	return operator new(sz);
+}
+
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+void operator delete[](void *p) noexcept {
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+	free(p);
+}
+
+enum DataKind
+{
+	DataText,
+	DataMesh,
+	DataRandom
+};
+
+struct Scenario
+{
+	const char *name;
+	uint32_t entry_count;
+	uint32_t entry_size;
+};
+
+struct Phase
+{
+	std::chrono::steady_clock::time_point start;
+	uint64_t allocs;
+	uint64_t bytes;
+};
+
+//small xorshift so every run generates the exact same archives
+struct Random
+{
+	Random(uint32_t seed) : state(seed ? seed : 1) { }
+
+	uint32_t Next() {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	uint32_t state;
+};
+
+void ResetPeakRSS() {
+#ifdef __linux__
+	//writing 5 to clear_refs resets the high water mark reported in /proc/self/status
+	FILE *f = fopen("/proc/self/clear_refs", "w");
+	if (f) {
+		fputs("5", f);
+		fclose(f);
+	}
+#endif
+}
+
+double PeakRSS() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+		return pmc.PeakWorkingSetSize / (1024.0 * 1024.0);
+	}
+	return 0.0;
+#else
+#ifdef __linux__
+	FILE *f = fopen("/proc/self/status", "r");
+	if (f) {
+		char line[256];
+		while (fgets(line, sizeof(line), f)) {
+			if (strncmp(line, "VmHWM:", 6) == 0) {
+				fclose(f);
+				return atof(line + 6) / 1024.0;
+			}
+		}
+		fclose(f);
+	}
+#endif
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+	return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+void GenerateData(DataKind kind, uint32_t seed, uint32_t size, std::vector<char> &out) {
+	static const char *words[] = { "zone", "model", "texture", "placeable", "terrain", "vertex", "polygon",
+		"material", "light", "region", "water", "lava", "collide", "bsp", "fragment", "actor" };
+
+	Random rng(seed);
+	out.resize(size);
+	if (kind == DataText) {
+		uint32_t i = 0;
+		while (i < size) {
+			const char *w = words[rng.Next() % 16];
+			while (*w && i < size) {
+				out[i++] = *w++;
+			}
+
+			if (i < size) {
+				out[i++] = (rng.Next() % 8) == 0 ? '\n' : ' ';
+			}
+		}
+	} else if (kind == DataMesh) {
+		//a noisy height field, close to what terrain and vertex buffers look like
+		uint32_t count = size / sizeof(float);
+		for (uint32_t i = 0; i < count; ++i) {
+			float v;
+			switch (i % 3) {
+			case 0:
+				v = (float)((i / 3) % 256) * 4.0f;
+				break;
+			case 1:
+				v = (float)((i / 3) / 256) * 4.0f;
+				break;
+			default:
+				v = (float)(rng.Next() % 64) * 0.25f;
+				break;
+			}
+			memcpy(&out[i * sizeof(float)], &v, sizeof(float));
+		}
+
+		for (uint32_t i = count * sizeof(float); i < size; ++i) {
+			out[i] = 0;
+		}
+	} else {
+		for (uint32_t i = 0; i < size; ++i) {
+			out[i] = (char)rng.Next();
+		}
+	}
+}
+
+std::string EntryName(uint32_t i) {
+	static const char *exts[] = { "wld", "bmp", "dds", "mod", "ter", "zon", "txt" };
+	char name[64];
+	snprintf(name, sizeof(name), "entry%05u.%s", i, exts[i % 7]);
+	return name;
+}
+
+Phase Begin() {
+	ResetPeakRSS();
+	Phase p;
+	p.allocs = alloc_count.load();
+	p.bytes = alloc_bytes.load();
+	p.start = std::chrono::steady_clock::now();
+	return p;
+}
+
+void End(const Phase &p, const char *scenario, const char *op, uint64_t ops, uint64_t bytes) {
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - p.start).count();
+	uint64_t allocs = alloc_count.load() - p.allocs;
+	uint64_t alloc_mb = (alloc_bytes.load() - p.bytes) / (1024 * 1024);
+	double rate = seconds > 0.0 ? ops / seconds : 0.0;
+	double mbs = seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+
+	printf("%-12s %-16s %10llu %12.1f %10.1f %12llu %10llu %10.1f\n", scenario, op, (unsigned long long)ops, rate, mbs,
+		(unsigned long long)allocs, (unsigned long long)alloc_mb, PeakRSS());
+}
+
+bool RunScenario(const Scenario &s, const std::string &dir) {
+	std::string path = dir + "/" + s.name + ".pfs";
+	uint64_t total = (uint64_t)s.entry_count * s.entry_size;
+
+	{
+		std::vector<std::vector<char>> contents(s.entry_count);
+		for (uint32_t i = 0; i < s.entry_count; ++i) {
+			GenerateData((DataKind)(i % 3), i + 1, s.entry_size, contents[i]);
+		}
+
+		EQEmu::PFS::Archive archive;
+		archive.Open();
+
+		Phase p = Begin();
+		for (uint32_t i = 0; i < s.entry_count; ++i) {
+			archive.Set(EntryName(i), contents[i]);
+		}
+		End(p, s.name, "Set", s.entry_count, total);
+
+		p = Begin();
+		if (!archive.Save(path)) {
+			printf("%-12s failed to save %s\n", s.name, path.c_str());
+			return false;
+		}
+		End(p, s.name, "Save", 1, total);
+	}
+
+	uint32_t opens = std::max(1u, 2048u / s.entry_count);
+	Phase p = Begin();
+	for (uint32_t i = 0; i < opens; ++i) {
+		EQEmu::PFS::Archive archive;
+		if (!archive.Open(path)) {
+			printf("%-12s failed to open %s\n", s.name, path.c_str());
+			return false;
+		}
+	}
+	End(p, s.name, "Open", opens, 0);
+
+	EQEmu::PFS::Archive archive;
+	if (!archive.Open(path)) {
+		return false;
+	}
+
+	std::vector<std::string> files;
+	uint32_t lists = std::max(1u, 65536u / s.entry_count);
+	p = Begin();
+	for (uint32_t i = 0; i < lists; ++i) {
+		files.clear();
+		archive.GetFilenames("*", files);
+	}
+	End(p, s.name, "GetFilenames *", lists, 0);
+
+	p = Begin();
+	for (uint32_t i = 0; i < lists; ++i) {
+		files.clear();
+		archive.GetFilenames("wld", files);
+	}
+	End(p, s.name, "GetFilenames wld", lists, 0);
+
+	std::vector<char> buf;
+	p = Begin();
+	for (uint32_t i = 0; i < s.entry_count; ++i) {
+		if (!archive.Get(EntryName(i), buf) || buf.size() != s.entry_size) {
+			printf("%-12s failed to get %s\n", s.name, EntryName(i).c_str());
+			return false;
+		}
+	}
+	End(p, s.name, "Get", s.entry_count, total);
+
+	p = Begin();
+	for (uint32_t i = 0; i < s.entry_count; ++i) {
+		archive.Read(EntryName(i), s.entry_size / 2, 64, buf);
+	}
+	End(p, s.name, "Read64", s.entry_count, (uint64_t)s.entry_count * 64);
+
+	archive.Close();
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+	return true;
+}
+
+void RunCompression() {
+	const uint32_t block_size = 8192;
+	const uint32_t blocks = 2048;
+	const char *names[] = { "text", "mesh", "random" };
+
+	for (int kind = 0; kind < 3; ++kind) {
+		std::vector<char> in;
+		GenerateData((DataKind)kind, 1234, block_size * blocks, in);
+
+		EQEmu::CompressionOptions opts;
+		uint32_t bound = EQEmu::DeflateBound(block_size, opts);
+		std::vector<char> out((size_t)bound * blocks);
+		std::vector<uint32_t> sizes(blocks);
+
+		std::string name = std::string("deflate/") + names[kind];
+		Phase p = Begin();
+		uint64_t compressed = 0;
+		for (uint32_t i = 0; i < blocks; ++i) {
+			sizes[i] = EQEmu::DeflateData(&in[i * block_size], block_size, &out[(size_t)i * bound], bound, opts);
+			compressed += sizes[i];
+		}
+		End(p, "compression", name.c_str(), blocks, (uint64_t)block_size * blocks);
+
+		std::vector<char> back(block_size);
+		name = std::string("inflate/") + names[kind];
+		p = Begin();
+		for (uint32_t i = 0; i < blocks; ++i) {
+			EQEmu::InflateData(&out[(size_t)i * bound], sizes[i], &back[0], block_size);
+		}
+		End(p, "compression", name.c_str(), blocks, (uint64_t)block_size * blocks);
+
+		printf("%-12s %-16s ratio %.2f%%\n", "compression", names[kind], 100.0 * compressed / ((double)block_size * blocks));
+	}
+}
+
+int main(int argc, char **argv) {
+	std::string dir;
+	if (argc > 1) {
+		dir = argv[1];
+	} else {
+		std::error_code ec;
+		dir = std::filesystem::temp_directory_path(ec).string();
+		if (ec) {
+			dir = ".";
+		}
+	}
+
+	//entry counts, sizes and compressibility chosen to cover directory heavy archives through to a few large entries
+	const Scenario scenarios[] = {
+		{ "tiny", 4096, 1024 },
+		{ "small", 1024, 16 * 1024 },
+		{ "medium", 128, 256 * 1024 },
+		{ "large", 8, 8 * 1024 * 1024 },
+	};
+
+	printf("%-12s %-16s %10s %12s %10s %12s %10s %10s\n", "scenario", "op", "count", "ops/s", "MB/s", "allocs", "alloc MB", "peak MB");
+
+	bool success = true;
+	for (auto &s : scenarios) {
+		if (!RunScenario(s, dir)) {
+			success = false;
+		}
+	}
+
+	RunCompression();
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}